@@ -243,6 +243,11 @@
 #define STM32_ICU_USE_TIM13                 FALSE
 #define STM32_ICU_USE_TIM14                 FALSE
 
+/*
+ * QEI driver system settings (various/quadEncoder.c).
+ */
+#define STM32_QEI_USE_TIM3                  TRUE
+
 /*
  * PWM driver system settings.
  */
@@ -370,7 +375,7 @@
 #define STM32_UART_UART5_RX_DMA_STREAM      STM32_DMA_STREAM_ID(1, 0)
 #define STM32_UART_UART5_TX_DMA_STREAM      STM32_DMA_STREAM_ID(1, 7)
 #define STM32_UART_USART6_RX_DMA_STREAM     STM32_DMA_STREAM_ID(2, 2)
-#define STM32_UART_USART6_TX_DMA_STREAM     STM32_DMA_STREAM_ID(2, 7)
+#define STM32_UART_USART6_TX_DMA_STREAM     STM32_DMA_STREAM_ID(2, 6)   /* (2, 7) is USART1 TX */
 #define STM32_UART_UART7_RX_DMA_STREAM      STM32_DMA_STREAM_ID(1, 3)
 #define STM32_UART_UART7_TX_DMA_STREAM      STM32_DMA_STREAM_ID(1, 1)
 #define STM32_UART_UART8_RX_DMA_STREAM      STM32_DMA_STREAM_ID(1, 6)
@@ -1,6 +1,7 @@
 #include "USS.h"
 #include "hal.h"
 #include "string.h"
+#include "uss_bcc.h"
 
 // 8 data bits, even parity, 1 stop bit, LSB first (standard)
 // time between 2 characters: less than 2x character time (22bits)
@@ -13,6 +14,8 @@
 // LGE: 1byte, telegram length, TX and LGE excluded.  LGE = n + 2
 
 // maximum telegram residual time = 1.5*(n+3)*character_time
+// The end of a stalled telegram is detected by the UART receiver timeout: the
+// line is idle for more than the maximum character delay (2 characters).
 
 // A task telegram is the transfer of a complete net data block from the master to the slave.
 // A response telegram is the transfer of the complete net data block from the slave to the master
@@ -23,12 +26,7 @@
 //   38400
 //   187500
 
-static void char_received(UARTDriver *uartp, uint16_t c);
-static void telegram_received(UARTDriver *uartp);
-static void error_cb(UARTDriver *uartp, uartflags_t e);
-static void telegram_sent(UARTDriver *uartp);
-static void residual_timeout_cb(GPTDriver *gptp);
-
+// The hardware is reached through the port, see uss_port.h
 
 /***
  *      _____    _                                  ____  __  __
@@ -41,71 +39,160 @@ static void residual_timeout_cb(GPTDriver *gptp);
 
 
 /**
- *  wait response delay time before sending the telegram in the txBuffer
+ * Send the telegram in txTelegram once the response delay has elapsed: the
+ * timer starts the transmission, without thread wake-up.
+ * Do not overwrite txTelegram before end of transmission.
+ * The timer must be free: no reception in progress.
  */
-static void txThd(void* arg) {
-    chRegSetThreadName("USS tx thread");
-    USSDriver* ussp = (USSDriver*)arg;
-    // 2 character time, rounded up.
-    uint32_t response_delay = 2*11*1000000/ussp->config->speed + 1;
-    while (true)
-    {
-        chBSemWait(&ussp->tx_sem);
-        if(chThdShouldTerminateX()) {
-            chThdExit(MSG_OK);
-        }
-        
-        if(!ussp->config->silent) {
-            palSetLine(ussp->config->rs485_en_line);
-        }
-        chThdSleepMicroseconds(response_delay);
-        uartStartSend(ussp->config->uartp, ussp->txTelegram.lge+2, (uint8_t*)&ussp->txTelegram);
-        ussp->txState = USS_TX_SENDING;
+static void sendTelegramI(USSDriver* ussp) {
+    if(!ussp->config->silent) {
+        ussPortSetTxEnable(ussp, true);
+    }
+    ussp->txState = USS_TX_RSP_WAIT;
+    ussPortStartTimeoutI(ussp, USS_TX_DELAY_BITS);
+}
+
+static void recordTxDelay(USSDriver* ussp, rtcnt_t cycles) {
+    USSDelayStats* st = &ussp->delayStats;
+    uint32_t us = RTC2US(STM32_SYSCLK, cycles);
+    uint32_t bin = us > st->target_us ? (us - st->target_us) / USS_DELAY_HIST_WIDTH_US : 0;
+    if(bin >= USS_DELAY_HIST_BINS) {
+        bin = USS_DELAY_HIST_BINS - 1;
+    }
+    st->hist[bin]++;
+    if(st->count == 0 || us < st->min_us) {
+        st->min_us = us;
+    }
+    if(us > st->max_us) {
+        st->max_us = us;
     }
+    st->count++;
+}
+
+static void recordGap(USSDriver* ussp) {
+    if(!ussp->lastRxEndValid || chTimeDiffX(ussp->lastRxEndTime, ussp->rxTime) > TIME_MS2I(1000)) {
+        // bus idle, not a gap
+        return;
+    }
+    USSStats* st = &ussp->stats;
+    uint32_t us = RTC2US(STM32_SYSCLK, ussp->rxCycles - ussp->lastRxEnd);
+    if(st->gaps == 0 || us < st->gap_min_us) {
+        st->gap_min_us = us;
+    }
+    if(us > st->gap_max_us) {
+        st->gap_max_us = us;
+    }
+    st->gap_total_us += us;
+    st->gaps++;
+}
+
+static uint8_t telegramBCC(const Telegram_t* tlgm) {
+    return ussBccWords((const uint8_t*)tlgm, tlgm->lge+1);
 }
 
 /**
- * Schedule a transmission of the telegram currently in the txBuffer.
- * Do not overwrite txBuffer before end of transmission
+ * Master mode: poll the nodes in turn.
+ * The next task is sent as soon as the start interval has elapsed after
+ * the response, or after the response timeout.
  */
-static void sendTelegram(USSDriver* ussp) {
-    ussp->txState = USS_TX_RSP_WAIT;
-    chSysLockFromISR();
-    chBSemSignalI(&ussp->tx_sem);
-    chSysUnlockFromISR();
+static void masterThd(void* arg) {
+    chRegSetThreadName("USS master");
+    USSDriver* ussp = (USSDriver*)arg;
+    const USSConfig* cfg = ussp->config;
+    const uint8_t net_len = 2 * (cfg->pkw_words + cfg->pzd_words);
+    // start interval, task and response: STX + LGE + ADR + net data + BCC, 11 bits per character,
+    // with up to 1.5 times the characters time for the response.
+    const uint32_t task_bits = USS_TX_DELAY_BITS + (net_len + 4) * 11;
+    const uint32_t rsp_bits = (net_len + 4) * 33 / 2;
+    // response delay at most 20ms
+    const sysinterval_t rsp_timeout = chTimeUS2I(20000 + (uint64_t)(task_bits + rsp_bits) * 1000000 / cfg->speed + 1);
+    uint8_t idx = 0;
+
+    while(!chThdShouldTerminateX()) {
+        if(cfg->nb_poll_nodes == 0) {
+            chThdSleepMilliseconds(100);
+            continue;
+        }
+        uint8_t node = cfg->poll_nodes[idx];
+        idx = (idx + 1) % cfg->nb_poll_nodes;
+
+        Telegram_t* tlgm = &ussp->txTelegram;
+        tlgm->stx = USS_STX;
+        tlgm->lge = net_len + 2;
+        tlgm->adr = node & 0x1F;
+        memset(tlgm->data, 0, net_len);
+        if(cfg->request_cb) {
+            cfg->request_cb(ussp, node, tlgm->data);
+        }
+        tlgm->data[net_len] = telegramBCC(tlgm);
+
+        chSysLock();
+        chBSemResetI(&ussp->rsp_sem, true);
+        ussp->pollNode = node;
+        ussp->polling = true;
+        sendTelegramI(ussp);
+
+        // polling, status and stats are also written by the reception ISR.
+        // The response may arrive between the timeout and the thread wake-up:
+        // check that the node is still being polled.
+        if(chBSemWaitTimeoutS(&ussp->rsp_sem, rsp_timeout) != MSG_OK && ussp->polling) {
+            ussp->polling = false;
+            ussp->status = USS_NO_RESPONSE;
+            ussp->stats.no_response++;
+        }
+        chSysUnlock();
+    }
 }
 
-
-static void error_cb(UARTDriver *uartp, uartflags_t e) {
-    (void)e;
-    USSDriver* ussp = (USSDriver*)uartp->ussp;
+void ussRxError(USSDriver* ussp, uint32_t errors) {
+    if(errors & USS_RX_ERR_PARITY) {
+        ussp->stats.parity_errors++;
+    }
+    if(errors & USS_RX_ERR_FRAMING) {
+        ussp->stats.framing_errors++;
+    }
+    if(errors & USS_RX_ERR_OVERRUN) {
+        ussp->stats.overrun_errors++;
+    }
+    if(errors & USS_RX_ERR_NOISE) {
+        ussp->stats.noise_errors++;
+    }
     // stop receiving current telegram, if any
     ussp->rxState = USS_RX_STX;
     chSysLockFromISR();
-    uartStopReceiveI(uartp);
+    ussPortStopReceiveI(ussp);
     chSysUnlockFromISR();
 }
 
 
-static void char_received(UARTDriver *uartp, uint16_t c) {
-    USSDriver* ussp = (USSDriver*)uartp->ussp;
-
+void ussRxChar(USSDriver* ussp, uint8_t c) {
     switch (ussp->rxState)
     {
     case USS_RX_STX:
         if(c == USS_STX) {   // start of telegram
-            ussp->rxTelegram.stx = c;
+            ussp->rxCycles = chSysGetRealtimeCounterX();
+            ussp->rxTime = chVTGetSystemTimeX();
+            recordGap(ussp);
+            ussp->status = USS_OK;
+            ussp->rxTelegram->stx = c;
             ussp->rxState = USS_RX_LGE;
         }
     break;
     case USS_RX_LGE:
     {
-        ussp->rxTelegram.lge = c;
+        ussp->rxTelegram->lge = c;
+        // STX and LGE part of the BCC, the rest is checked at the end of the DMA reception
+        ussp->rxBcc = USS_STX ^ c;
+        // ADR + data + BCC must fit in the buffer
+        if(c < 2 || c > USS_TELEGRAM_LEN + 1) {
+            ussp->status = USS_RX_BAD_LGE;
+            ussp->stats.bad_lge++;
+            ussp->rxState = USS_RX_STX;
+            break;
+        }
         // setup DMA to receive telegram in ussp->buffer
         chSysLockFromISR();
-        uartStartReceiveI(uartp, ussp->rxTelegram.lge, (uint8_t*)&ussp->rxTelegram.adr);
-        uint16_t residual_time = (1.5*ussp->rxTelegram.lge*11-1) * ussp->gpt_freq / ussp->config->speed;
-        gptStartOneShotI(ussp->config->gpt, residual_time);
+        ussPortReceiveI(ussp, ussp->rxTelegram->lge, (uint8_t*)&ussp->rxTelegram->adr);
         chSysUnlockFromISR();
         ussp->rxState = USS_RX_RESIDUAL;
     }
@@ -120,105 +207,169 @@ static void char_received(UARTDriver *uartp, uint16_t c) {
     }
 }
 
-uint8_t getBCC(USSDriver* ussp) {
-    return ussp->rxTelegram.data[ussp->rxTelegram.lge-2];
-}
-
-uint8_t computeBCC(USSDriver* ussp) {
-    uint8_t bcc = 0;
-    for(uint8_t i=0; i<ussp->rxTelegram.lge+1; i++) {
-        bcc ^= ((uint8_t*)&ussp->rxTelegram)[i];
-    }
-    return bcc;
-}
-
-static void telegram_received(UARTDriver *uartp) {
-    USSDriver* ussp = (USSDriver*)uartp->ussp;
+void ussRxEnd(USSDriver* ussp) {
+    ussp->txDelayRef = chSysGetRealtimeCounterX();
+    ussp->txDelayRefValid = true;
+    ussp->lastRxEnd = ussp->txDelayRef;
+    ussp->lastRxEndTime = chVTGetSystemTimeX();
+    ussp->lastRxEndValid = true;
     ussp->rxState = USS_RX_STX;
-    // cancel the residual time timeout
-    chSysLockFromISR();
-    gptStopTimerI(ussp->config->gpt);
-    chSysUnlockFromISR();
-    
-    if(getBCC(ussp) != computeBCC(ussp)) {
+
+    // XOR of ADR, data and BCC: must cancel STX ^ LGE
+    if(ussBccWords(&ussp->rxTelegram->adr, ussp->rxTelegram->lge) != ussp->rxBcc) {
         ussp->status = USS_BCC_MISMATCH;
+        ussp->stats.bcc_errors++;
+        if(ussp->config->any_cb) {
+            ussp->config->any_cb(ussp);
+        }
         return;
     }
 
-    // callback reacting to all telegrams
-    if(ussp->config->any_cb) {
-        ussp->config->any_cb(ussp);
+    const uint8_t adr = ussp->rxTelegram->adr;
+    if(adr & 0x80) {
+        ussp->stats.special++;
+    } else if(adr & 0x40) {
+        ussp->stats.mirror++;
+    } else if(adr & 0x20) {
+        ussp->stats.broadcast++;
+    } else {
+        ussp->stats.standard++;
     }
 
+    bool response = false;
+    if(ussp->config->mode == USS_MODE_MASTER) {
+        // response of the polled node
+        if(ussp->polling && (ussp->rxTelegram->adr & 0xE0) == 0 && (ussp->rxTelegram->adr & 0x1F) == ussp->pollNode) {
+            ussp->polling = false;
+            response = true;
+            if(ussp->config->standard_cb) {
+                ussp->config->standard_cb(ussp);
+            }
+        }
+    }
     // special telegram
-    if(ussp->rxTelegram.adr & 0x80) {
+    else if(ussp->rxTelegram->adr & 0x80) {
         if(ussp->config->special_cb) {
             ussp->config->special_cb(ussp);
         }
-        return;
     }
-
     // mirror telegram: The node number is evaluated and the
     // addressed slave returns the telegram, unchanged, to the master
-    if((ussp->rxTelegram.adr & 0x40) && ((ussp->rxTelegram.adr & 0x1F) == ussp->config->node_nb)) {
-        memcpy(&ussp->txTelegram, &ussp->rxTelegram, ussp->rxTelegram.lge+2);
-        sendTelegram(ussp);
-        return;
+    else if((ussp->rxTelegram->adr & 0x40) && ((ussp->rxTelegram->adr & 0x1F) == ussp->config->node_nb)) {
+        chSysLockFromISR();
+        if(ussp->txState == USS_TX_IDLE) {
+            memcpy(&ussp->txTelegram, ussp->rxTelegram, ussp->rxTelegram->lge+2);
+            sendTelegramI(ussp);
+        } else {
+            // previous reply not sent yet: txTelegram and the timer are busy
+            ussp->stats.mirror_drops++;
+        }
+        chSysUnlockFromISR();
     }
-
     // broadcast telegram. Node number not evaluated
-    if(ussp->rxTelegram.adr & 0x20) {
+    else if(ussp->rxTelegram->adr & 0x20) {
         if(ussp->config->broadcast_cb) {
             ussp->config->broadcast_cb(ussp);
         }
-        return;
     }
-
     // standard data transfer. Node number is evaluated
-    if((ussp->rxTelegram.adr & 0xE0) == 0 && ((ussp->rxTelegram.adr & 0x1F) == ussp->config->node_nb)) {
+    else if((ussp->rxTelegram->adr & 0xE0) == 0 && ((ussp->rxTelegram->adr & 0x1F) == ussp->config->node_nb)) {
         if(ussp->config->standard_cb) {
             ussp->config->standard_cb(ussp);
         }
-        return;
     }
-}
 
-/**
- * telegram residual time expired
- */
-static void residual_timeout_cb(GPTDriver *gptp) {
-    USSDriver* ussp = (USSDriver*)gptp->ussp;
-    chSysLockFromISR();
-    uartStopReceiveI(ussp->config->uartp);
-    chSysUnlockFromISR();
-    ussp->rxState = USS_RX_STX;
+    // callback reacting to all telegrams, last since it may take the rx buffer
+    if(ussp->config->any_cb) {
+        ussp->config->any_cb(ussp);
+    }
+
+    if(response) {
+        // poll the next node
+        chSysLockFromISR();
+        chBSemSignalI(&ussp->rsp_sem);
+        chSysUnlockFromISR();
+    }
 }
 
+Telegram_t* ussSwapRxTelegramI(USSDriver* ussp, Telegram_t* fresh) {
+    Telegram_t* tlgm = ussp->rxTelegram;
+    ussp->rxTelegram = fresh;
+    return tlgm;
+}
 
-static void telegram_sent(UARTDriver *uartp) {
-    USSDriver* ussp = (USSDriver*)uartp->ussp;
-    ussp->txState = USS_TX_IDLE;
-    palClearLine(ussp->config->rs485_en_line);
+void ussGetDelayStats(USSDriver* ussp, USSDelayStats* stats) {
+    chSysLock();
+    *stats = ussp->delayStats;
+    chSysUnlock();
 }
 
+void ussResetDelayStats(USSDriver* ussp) {
+    chSysLock();
+    memset(&ussp->delayStats, 0, sizeof(ussp->delayStats));
+    ussp->delayStats.target_us = (USS_TX_DELAY_BITS * 1000000 + ussp->config->speed - 1) / ussp->config->speed;
+    chSysUnlock();
+}
 
-/***
- *          _       _                                            
- *       __| | __ _| |_ __ _   _ __  _ __ ___   ___ ___  ___ ___ 
- *      / _` |/ _` | __/ _` | | '_ \| '__/ _ \ / __/ _ \/ __/ __|
- *     | (_| | (_| | || (_| | | |_) | | | (_) | (_|  __/\__ \__ \
- *      \__,_|\__,_|\__\__,_| | .__/|_|  \___/ \___\___||___/___/
- *                            |_|                                
- */
+void ussGetStats(USSDriver* ussp, USSStats* stats) {
+    chSysLock();
+    *stats = ussp->stats;
+    chSysUnlock();
+}
 
-void data_process(USSDriver *ussp) {
-    // ussp->rxBuffer
-    // ussp->lge
+void ussResetStats(USSDriver* ussp) {
+    chSysLock();
+    memset(&ussp->stats, 0, sizeof(ussp->stats));
+    chSysUnlock();
+}
 
+/**
+ * response delay elapsed: start the transmission
+ */
+void ussTimeout(USSDriver* ussp) {
+    if(ussp->txState != USS_TX_RSP_WAIT) {
+        return;
+    }
+    rtcnt_t now = chSysGetRealtimeCounterX();
+    chSysLockFromISR();
+    ussPortSendI(ussp, ussp->txTelegram.lge+2, (uint8_t*)&ussp->txTelegram);
+    chSysUnlockFromISR();
+    ussp->txState = USS_TX_SENDING;
+    if(ussp->txDelayRefValid) {
+        recordTxDelay(ussp, now - ussp->txDelayRef);
+    }
+    ussp->txDelayRefValid = false;
+}
 
+/**
+ * line idle: end of a stalled telegram, if any
+ */
+void ussRxIdle(USSDriver* ussp) {
+    if(ussp->rxState == USS_RX_LGE) {
+        // STX alone
+        ussp->rxState = USS_RX_STX;
+        return;
+    }
+    if(ussp->rxState != USS_RX_RESIDUAL) {
+        // telegram already complete
+        return;
+    }
+    chSysLockFromISR();
+    ussPortStopReceiveI(ussp);
+    chSysUnlockFromISR();
+    ussp->rxState = USS_RX_STX;
+    ussp->status = USS_RX_TIMEOUT;
+    ussp->stats.timeouts++;
+    if(ussp->config->any_cb) {
+        ussp->config->any_cb(ussp);
+    }
 }
 
 
+void ussTxEnd(USSDriver* ussp) {
+    ussp->txState = USS_TX_IDLE;
+    ussPortSetTxEnable(ussp, false);
+}
 
 
 /***
@@ -233,45 +384,37 @@ void data_process(USSDriver *ussp) {
 
 void ussStart(USSDriver *ussp, const USSConfig *usscfg)
 {
-    // UART driver config
-    ussp->uartConfig.txend1_cb = NULL;                // End of transmission buffer callback.
-    ussp->uartConfig.txend2_cb = telegram_sent;       //Physical end of transmission callback.
-    ussp->uartConfig.rxend_cb = telegram_received;    //Receive buffer filled callback.
-    ussp->uartConfig.rxchar_cb = char_received;       //Character received while out if the @p UART_RECEIVE state.
-    ussp->uartConfig.rxerr_cb = error_cb;             //Receive error callback.
-    ussp->uartConfig.timeout_cb = NULL;
-    ussp->uartConfig.timeout = 0;
-    ussp->uartConfig.speed = usscfg->speed;
-    ussp->uartConfig.cr1 = USART_CR1_PCE | USART_CR1_M_0;   // parity enabled | 9 bits (including parity bit)
-    ussp->uartConfig.cr2 = USART_CR2_STOP1_BITS | USART_CR2_LINEN;
-    ussp->uartConfig.cr3 = 0;
-
-    // GPT driver config
-    ussp->gpt_freq = 100000;
-    ussp->gptConfig.frequency = (uint32_t)ussp->gpt_freq;
-    ussp->gptConfig.callback = residual_timeout_cb;
-    ussp->gptConfig.cr2 = 0;
-    ussp->gptConfig.dier = 0;
-
     ussp->config = usscfg;
-    usscfg->uartp->ussp = ussp;
+    if(ussp->rxTelegram == NULL) {
+        // no buffer given with ussSwapRxTelegramI before start
+        ussp->rxTelegram = &ussp->rxBuffer;
+    }
     ussp->rxState = USS_RX_STX;
     ussp->txState = USS_TX_IDLE;
     ussp->status = USS_OK;
-    chBSemObjectInit(&ussp->tx_sem, true);
+    chBSemObjectInit(&ussp->rsp_sem, true);
+    ussp->polling = false;
+    ussp->txDelayRefValid = false;
+    ussp->lastRxEndValid = false;
+    ussResetDelayStats(ussp);
+    ussResetStats(ussp);
+
+    chDbgAssert(2*(usscfg->pkw_words + usscfg->pzd_words) < USS_TELEGRAM_LEN, "USS net data too long");
 
-    ussp->tx_thread = chThdCreateStatic(ussp->waTxThread, sizeof(ussp->waTxThread), NORMALPRIO + 1, txThd, ussp);
-    palClearLine(usscfg->rs485_en_line);
-    uartStart(ussp->config->uartp, &ussp->uartConfig);
-    gptStart(ussp->config->gpt, &ussp->gptConfig);
+    ussPortStart(ussp);
+    ussp->tx_thread = NULL;
+    if(usscfg->mode == USS_MODE_MASTER) {
+        ussp->tx_thread = chThdCreateStatic(ussp->waTxThread, sizeof(ussp->waTxThread), NORMALPRIO + 1, masterThd, ussp);
+    }
 }
 
 
 void ussStop(USSDriver* ussp) {
-    chThdTerminate(ussp->tx_thread);
-    chBSemSignal(&ussp->tx_sem);
-    uartStop(ussp->config->uartp);
-    gptStop(ussp->config->gpt);
-    chThdWait(ussp->tx_thread);
-    ussp->tx_thread = NULL;
+    if(ussp->tx_thread) {
+        chThdTerminate(ussp->tx_thread);
+        chBSemSignal(&ussp->rsp_sem);
+        chThdWait(ussp->tx_thread);
+        ussp->tx_thread = NULL;
+    }
+    ussPortStop(ussp);
 }
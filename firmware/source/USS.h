@@ -1,11 +1,20 @@
 #pragma once
 #include "hal.h"
 #include "ch.h"
+#include "uss_port.h"
 
 #define USS_STX 0x02
 
 #define USS_TELEGRAM_LEN 50
 
+// response delay (slave) and start interval (master): 2 character times
+#define USS_TX_DELAY_BITS 22
+// maximum delay between 2 characters of a telegram: 2 character times
+#define USS_RX_IDLE_BITS 22
+
+#define USS_DELAY_HIST_BINS 16
+#define USS_DELAY_HIST_WIDTH_US 2
+
 
 typedef struct USSDriver_private USSDriver;
 typedef void (*usscb_t)(USSDriver *ussp);
@@ -23,24 +32,54 @@ typedef enum {
     USS_TX_SENDING,     // transmission pending
 } USSTxState;
 
+// keep STATUS of tools/uss_log_parse.py in sync
 typedef enum {
     USS_OK,
     USS_BCC_MISMATCH,
+    USS_RX_TIMEOUT,         // line idle before the end of the telegram
+    USS_RX_BAD_LGE,         // LGE too short or does not fit in the telegram buffer
+    USS_NO_RESPONSE,        // master: the polled node did not respond
 } USSError;
 
+// reception errors reported by the port
+typedef enum {
+    USS_RX_ERR_PARITY = 1 << 0,
+    USS_RX_ERR_FRAMING = 1 << 1,
+    USS_RX_ERR_OVERRUN = 1 << 2,
+    USS_RX_ERR_NOISE = 1 << 3,
+} USSRxErrorFlags;
+
+typedef enum {
+    USS_MODE_SLAVE,         // answer mirror telegrams, report the telegrams received
+    USS_MODE_MASTER,        // poll the nodes of the poll list cyclically
+} USSMode;
+
+/**
+ * Master mode: fill the net data of the task telegram for `node`.
+ * `data` holds the PKW words then the PZD words, big endian, zeroed.
+ */
+typedef void (*ussrequestcb_t)(USSDriver *ussp, uint8_t node, uint8_t* data);
+
 
 typedef struct {
     UARTDriver* uartp;      // UART driver
-    ioline_t rs485_en_line;
+    ioline_t rs485_en_line; // RS485 driver enable, PAL_NOLINE if automatic
     GPTDriver* gpt;
     uint32_t speed;         // UART baudrate
     uint8_t node_nb;        // node id
     usscb_t standard_cb;    // standard telegram received callback
     usscb_t broadcast_cb;   // broadcast telegram received callback
     usscb_t special_cb;     // special telegram received callback (probably NULL)
-    usscb_t any_cb;         // any telegram received callback
+    usscb_t any_cb;         // any telegram received callback, also called on reception errors (see status)
     bool silent;            // set to true to never emit frames
     void* user_data;
+    USSMode mode;
+    // master mode. Responses are reported to standard_cb, with pollNode set.
+    const uint8_t* poll_nodes;  // nodes polled in turn
+    uint8_t nb_poll_nodes;
+    uint8_t pkw_words;          // PKW area length, in words (0, 3 or 4)
+    uint8_t pzd_words;          // PZD area length, in words (0 to 16)
+    ussrequestcb_t request_cb;  // fill the task telegrams
 } USSConfig;
 
 
@@ -93,6 +132,40 @@ typedef struct {
     uint16_t ind_low: 8;
 } pkw_t;
 
+// Bus statistics, counted since start or the last reset
+typedef struct {
+    // valid telegrams, whatever the node, per type
+    uint32_t standard;
+    uint32_t broadcast;
+    uint32_t mirror;
+    uint32_t special;
+    // errors
+    uint32_t bcc_errors;
+    uint32_t parity_errors;
+    uint32_t framing_errors;
+    uint32_t overrun_errors;
+    uint32_t noise_errors;
+    uint32_t timeouts;          // line idle before the end of a telegram
+    uint32_t bad_lge;
+    uint32_t no_response;       // master: polled node did not respond
+    uint32_t mirror_drops;      // mirror telegram not answered, previous reply still being sent
+    // gap between the end of a telegram and the STX of the next one, below 1s
+    uint32_t gaps;
+    uint32_t gap_min_us;
+    uint32_t gap_max_us;
+    uint64_t gap_total_us;
+} USSStats;
+
+// Measured delay between the end of the last received telegram and the start
+// of the transmission
+typedef struct {
+    uint32_t target_us;     // USS_TX_DELAY_BITS, rounded up to the timer resolution
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t hist[USS_DELAY_HIST_BINS];     // delay - target, USS_DELAY_HIST_WIDTH_US per bin, the last bin also gets the longer delays
+} USSDelayStats;
+
 typedef struct {
     uint8_t stx;
     uint8_t lge;
@@ -102,18 +175,33 @@ typedef struct {
 
 struct USSDriver_private{
     const USSConfig* config;
-    UARTConfig uartConfig;  // UART config
-    GPTConfig  gptConfig;   // GPT driver config
-    float gpt_freq;
+    UssPort port;           // hardware port data
     USSRxState rxState;
     USSTxState txState;
-    USSError status;
-    
-    Telegram_t rxTelegram;
+    USSError status;        // status of the last telegram reception
+    rtcnt_t rxCycles;       // realtime counter at STX of the last telegram
+    systime_t rxTime;       // system time at STX of the last telegram
+
+    Telegram_t* rxTelegram; // telegram being received, DMA target
+    uint8_t rxBcc;          // BCC of STX and LGE
+    Telegram_t rxBuffer;    // default reception buffer
     Telegram_t txTelegram;
 
-    binary_semaphore_t tx_sem;
-    thread_t* tx_thread;
+    thread_t* tx_thread;    // polling thread (master)
+
+    // master mode
+    binary_semaphore_t rsp_sem;     // signaled on the response of the polled node
+    volatile bool polling;          // waiting for the response of pollNode
+    uint8_t pollNode;
+
+    rtcnt_t txDelayRef;         // end of the last telegram received
+    bool txDelayRefValid;       // a telegram was received since the last transmission
+    USSDelayStats delayStats;
+
+    rtcnt_t lastRxEnd;          // end of the last telegram, for the gaps
+    systime_t lastRxEndTime;
+    bool lastRxEndValid;
+    USSStats stats;
     THD_WORKING_AREA(waTxThread, 512);
 
     
@@ -122,4 +210,17 @@ struct USSDriver_private{
 void ussStart(USSDriver* ussp, const USSConfig* usscfg);
 void ussStop(USSDriver* ussp);
 
+/**
+ * Hand over the telegram just received and receive the next ones in `fresh`.
+ * Only call from the telegram callbacks (ISR context, locked), or before
+ * ussStart to give the first reception buffer.
+ * @return the received telegram, now owned by the caller.
+ */
+Telegram_t* ussSwapRxTelegramI(USSDriver* ussp, Telegram_t* fresh);
+
+void ussGetDelayStats(USSDriver* ussp, USSDelayStats* stats);
+void ussResetDelayStats(USSDriver* ussp);
+void ussGetStats(USSDriver* ussp, USSStats* stats);
+void ussResetStats(USSDriver* ussp);
+
 
@@ -0,0 +1,20 @@
+#include "airspeed.h"
+#include <math.h>
+
+#define R_DRY_AIR 287.058f      // J/(kg.K)
+#define R_VAPOR 461.495f        // J/(kg.K)
+#define ZERO_CELSIUS 273.15f
+
+/**
+ * Saturation vapor pressure over water, in Pa (Arden Buck equation).
+ */
+static float saturationVaporPressure(float temp) {
+    return 611.21f * expf((18.678f - temp * (1.0f / 234.5f)) * (temp / (257.14f + temp)));
+}
+
+float airDensity(float pressure, float temp, float rh) {
+    const float p_vapor = rh * 0.01f * saturationVaporPressure(temp);
+    const float p_dry = pressure - p_vapor;
+    const float inv_t = 1.0f / (temp + ZERO_CELSIUS);
+    return (p_dry * (1.0f / R_DRY_AIR) + p_vapor * (1.0f / R_VAPOR)) * inv_t;
+}
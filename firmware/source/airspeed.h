@@ -0,0 +1,37 @@
+#pragma once
+
+// Airspeed from pitot differential pressure: v = sqrt(2*dp/rho)
+// with rho the density of moist air, computed from the absolute pressure,
+// the temperature and the relative humidity of the tunnel air.
+//
+// Density changes slowly: compute it and its airspeed factor 2/rho when
+// pressure, temperature or humidity are updated, then airspeedFromDp is only
+// a multiply and a single precision square root (VSQRT.F32 with the FPU).
+
+#define AIR_DENSITY_STD 1.225f         // kg/m³, ISA sea level
+
+/**
+ * Density of moist air, in kg/m³.
+ * @param pressure      absolute pressure, in Pa
+ * @param temp          air temperature, in °C
+ * @param rh            relative humidity, in %
+ */
+float airDensity(float pressure, float temp, float rh);
+
+/**
+ * Airspeed factor 2/rho of airspeedFromDp, in m³/kg.
+ * @param density       air density, in kg/m³
+ */
+static inline float airspeedFactor(float density) {
+    return 2.0f / density;
+}
+
+/**
+ * Airspeed in m/s, negative if the differential pressure is negative.
+ * @param dp            differential pressure, in Pa
+ * @param factor        airspeedFactor() of the air density
+ */
+static inline float airspeedFromDp(float dp, float factor) {
+    float v = __builtin_sqrtf(__builtin_fabsf(dp) * factor);
+    return dp < 0 ? -v : v;
+}
@@ -0,0 +1,104 @@
+#include "bench.h"
+#include "ch.h"
+#include "airspeed.h"
+#include "uss_bcc.h"
+#include "fixed_format.h"
+extern "C" {
+    #include "i2cPeriphSHT4x.h"
+}
+
+// inputs are read through volatiles so that the compiler cannot hoist
+// the computation out of the loop, results are written to a volatile sink.
+static volatile uint16_t raw_in = 0x6666;
+static volatile float dp_in = 123.4f;
+static volatile float pressure_in = 101325.0f;
+static volatile float temp_in = 21.5f;
+static volatile float rh_in = 45.0f;
+static volatile float factor_in = 2.0f / AIR_DENSITY_STD;
+static volatile float sink_f;
+static volatile int sink_i;
+// longest telegram, at an unaligned offset like in the log records
+static uint8_t tlgm_in[2 + 53];
+static volatile size_t tlgm_len = 51;
+
+// the 32 bits realtime counter wraps after 19.9s at 216MHz: loops are timed
+// by chunks short enough to never wrap, and the chunks are summed on 64 bits
+#define BENCH_CHUNK 1000U
+
+/**
+ * Average cycles per call of f, loop overhead removed.
+ */
+template <typename F>
+static uint32_t benchCycles(uint32_t iterations, F f) {
+    uint64_t overhead = 0;
+    uint64_t total = 0;
+    for(uint32_t left=iterations; left>0; ) {
+        const uint32_t n = left < BENCH_CHUNK ? left : BENCH_CHUNK;
+        rtcnt_t t0 = chSysGetRealtimeCounterX();
+        for(uint32_t i=0; i<n; i++) {
+            (void)raw_in;
+        }
+        overhead += chSysGetRealtimeCounterX() - t0;
+
+        t0 = chSysGetRealtimeCounterX();
+        for(uint32_t i=0; i<n; i++) {
+            (void)raw_in;
+            f();
+        }
+        total += chSysGetRealtimeCounterX() - t0;
+        left -= n;
+    }
+    return total > overhead ? (uint32_t)((total - overhead) / iterations) : 0;
+}
+
+static void printBench(BaseSequentialStream *lchp, const char* name, uint32_t cycles) {
+    chprintf(lchp, "  %-24s %8lu cycles %8lu ns\r\n", name, cycles,
+             (uint32_t)((uint64_t)cycles * 1000000000ULL / STM32_SYSCLK));
+}
+
+void runBenchmarks(BaseSequentialStream *lchp, uint32_t iterations) {
+    char buffer[16];
+
+    chprintf(lchp, "%lu iterations, FPU %s\r\n", iterations,
+#if CORTEX_USE_FPU
+             "enabled"
+#else
+             "disabled"
+#endif
+            );
+
+    chprintf(lchp, "sensor conversion:\r\n");
+    printBench(lchp, "sht4x temperature", benchCycles(iterations, [] {
+        sink_f = sht4xRawToTemp(raw_in);
+    }));
+    printBench(lchp, "sht4x humidity", benchCycles(iterations, [] {
+        sink_f = sht4xRawToRH(raw_in);
+    }));
+
+    chprintf(lchp, "airspeed:\r\n");
+    printBench(lchp, "air density", benchCycles(iterations, [] {
+        sink_f = airDensity(pressure_in, temp_in, rh_in);
+    }));
+    printBench(lchp, "airspeed from dp", benchCycles(iterations, [] {
+        sink_f = airspeedFromDp(dp_in, factor_in);
+    }));
+
+    chprintf(lchp, "USS BCC, %u bytes:\r\n", (unsigned)tlgm_len);
+    for(size_t i=0; i<sizeof(tlgm_in); i++) {
+        tlgm_in[i] = i * 37;
+    }
+    printBench(lchp, "bytes loop", benchCycles(iterations, [] {
+        sink_i = ussBccBytes(tlgm_in + 2, tlgm_len);
+    }));
+    printBench(lchp, "words loop", benchCycles(iterations, [] {
+        sink_i = ussBccWords(tlgm_in + 2, tlgm_len);
+    }));
+
+    chprintf(lchp, "formatting:\r\n");
+    printBench(lchp, "chsnprintf %6.2f", benchCycles(iterations, [&buffer] {
+        sink_i = chsnprintf(buffer, sizeof(buffer), "%6.2f", dp_in);
+    }));
+    printBench(lchp, "fmtFloat 6, 2", benchCycles(iterations, [&buffer] {
+        sink_i = fmtFloat(buffer, dp_in, 6, 2) - buffer;
+    }));
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "hal.h"
+
+/**
+ * Run the on-target benchmarks and print the cycle count per call
+ * (DWT cycle counter, through the ChibiOS realtime counter).
+ */
+void runBenchmarks(BaseSequentialStream *lchp, uint32_t iterations);
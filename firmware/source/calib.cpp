@@ -0,0 +1,180 @@
+#include "calib.h"
+#include <stddef.h>
+#include "ff.h"
+#include "stdutil.h"
+#include "printf.h"
+#include "sd.h"
+#include "sensors.h"
+#include "uss_handler.h"
+#include "uss_parser.h"
+
+#define TARE_EVENT EVENT_MASK(0)
+
+// The record is read and rewritten whole under a fixed name, FatFS is used
+// directly: the sdLog files are append only, with generated names.
+// FIL holds a sector buffer, used for the SDIO DMA transfers
+static IN_DMA_SECTION(FIL calib_file);
+static MUTEX_DECL(calib_mtx);
+// set once a calibration is applied, the stored one is then not loaded again
+static bool calib_applied = false;
+static thread_t* calib_thd = NULL;
+
+static uint32_t fnv1a(const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t h = 2166136261u;
+    for(size_t i=0; i<len; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static CalibStatus writeRecord(float offset, float gain) {
+    if(!startSdLog(TIME_MS2I(500))) {
+        return CALIB_NO_SD;
+    }
+    CalibRecord rec = {
+        .magic = CALIB_MAGIC,
+        .version = CALIB_VERSION,
+        .reserved = 0,
+        .dp_offset = offset,
+        .dp_gain = gain,
+        .check = 0,
+    };
+    rec.check = fnv1a(&rec, offsetof(CalibRecord, check));
+
+    if(f_open(&calib_file, CALIB_FILE, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        return CALIB_FILE_ERROR;
+    }
+    UINT written = 0;
+    FRESULT res = f_write(&calib_file, &rec, sizeof(rec), &written);
+    if(f_close(&calib_file) != FR_OK || res != FR_OK || written != sizeof(rec)) {
+        return CALIB_FILE_ERROR;
+    }
+    return CALIB_OK;
+}
+
+CalibStatus loadCalibration() {
+    chMtxLock(&calib_mtx);
+    CalibStatus status = CALIB_OK;
+    CalibRecord rec;
+    UINT len = 0;
+    if(calib_applied) {
+        status = CALIB_OK;
+    } else if(!startSdLog(TIME_MS2I(500))) {
+        status = CALIB_NO_SD;
+    } else if(f_open(&calib_file, CALIB_FILE, FA_READ) != FR_OK) {
+        status = CALIB_FILE_ERROR;
+    } else {
+        FRESULT res = f_read(&calib_file, &rec, sizeof(rec), &len);
+        f_close(&calib_file);
+        if(res != FR_OK || len != sizeof(rec) ||
+           rec.magic != CALIB_MAGIC || rec.version != CALIB_VERSION ||
+           rec.check != fnv1a(&rec, offsetof(CalibRecord, check))) {
+            status = CALIB_FILE_ERROR;
+        } else {
+            setDpCalibration(rec.dp_offset, rec.dp_gain);
+            calib_applied = true;
+        }
+    }
+    chMtxUnlock(&calib_mtx);
+    return status;
+}
+
+CalibStatus tareDp(uint16_t nb_samples) {
+    DriveState drive = getDriveState();
+    if(drive.valid && (drive.status_word & USS_ZSW_RUNNING)) {
+        return CALIB_FAN_RUNNING;
+    }
+
+    chMtxLock(&calib_mtx);
+    // twice the nominal duration
+    const sysinterval_t timeout = 2 * getSensorPeriod("SDP3x") * nb_samples + TIME_MS2I(100);
+    float offset;
+    CalibStatus status = CALIB_TARE_TIMEOUT;
+    if(measureDpOffset(nb_samples, timeout, &offset) == MSG_OK) {
+        float old_offset, gain;
+        getDpCalibration(&old_offset, &gain);
+        setDpCalibration(offset, gain);
+        calib_applied = true;
+        status = writeRecord(offset, gain);
+    }
+    chMtxUnlock(&calib_mtx);
+    return status;
+}
+
+CalibStatus setDpGain(float gain) {
+    chMtxLock(&calib_mtx);
+    float offset, old_gain;
+    getDpCalibration(&offset, &old_gain);
+    setDpCalibration(offset, gain);
+    calib_applied = true;
+    CalibStatus status = writeRecord(offset, gain);
+    chMtxUnlock(&calib_mtx);
+    return status;
+}
+
+CalibStatus clearCalibration() {
+    chMtxLock(&calib_mtx);
+    setDpCalibration(0.0f, 1.0f);
+    calib_applied = true;
+    CalibStatus status = writeRecord(0.0f, 1.0f);
+    chMtxUnlock(&calib_mtx);
+    return status;
+}
+
+static THD_WORKING_AREA(waCalib, 2048);
+static void calibThd(void*) {
+    chRegSetThreadName("calib");
+    bool load_pending = true;
+    while(true) {
+        // the loading is retried until the SD card is there, it waits for it
+        // up to 500ms: a tare request is served in between
+        const eventmask_t events = chEvtWaitAnyTimeout(TARE_EVENT, load_pending ? TIME_IMMEDIATE : TIME_INFINITE);
+        if(events & TARE_EVENT) {
+            const CalibStatus status = tareDp(TARE_SAMPLES);
+            if(status != CALIB_OK) {
+                DebugTrace("tare: %s", calibStatusString(status));
+            }
+        }
+        if(load_pending) {
+            const CalibStatus status = loadCalibration();
+            load_pending = status == CALIB_NO_SD;
+            if(status == CALIB_FILE_ERROR) {
+                DebugTrace("load calibration: %s", calibStatusString(status));
+            }
+        }
+    }
+}
+
+void startCalibration(tprio_t prio) {
+    calib_thd = chThdCreateStatic(waCalib, sizeof(waCalib), prio, calibThd, NULL);
+}
+
+void requestTare() {
+    if(calib_thd != NULL) {
+        chEvtSignal(calib_thd, TARE_EVENT);
+    }
+}
+
+const char* calibStatusString(CalibStatus status) {
+    switch (status)
+    {
+    case CALIB_OK:
+        return "ok";
+    case CALIB_FAN_RUNNING:
+        return "fan running";
+    case CALIB_TARE_TIMEOUT:
+        return "no differential pressure samples";
+    case CALIB_NO_SD:
+        return "no SD card";
+    case CALIB_FILE_ERROR:
+        return "calibration file error";
+    }
+    return "?";
+}
+
+void printCalibration(BaseSequentialStream* lchp) {
+    float offset, gain;
+    getDpCalibration(&offset, &gain);
+    chprintf(lchp, "dp offset %.3f Pa, gain %.5f\r\n", offset, gain);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include "ch.h"
+#include "hal.h"
+
+// Differential pressure calibration: dp = gain * (raw - offset).
+// The record is stored on the SD card and loaded by the calibration thread,
+// the samples are uncalibrated until then (offset 0, gain 1). The offset is
+// measured by the tare procedure, fan stopped: the SDP3x zero drifts with
+// time and temperature, the gain is only set by hand.
+
+#define CALIB_FILE "dp_calib.bin"
+#define CALIB_MAGIC 0x4344          // "DC"
+#define CALIB_VERSION 1
+#define TARE_SAMPLES 400            // 2s of SDP3x samples at 200Hz
+
+typedef struct {
+    uint16_t magic;                 // CALIB_MAGIC
+    uint8_t version;                // CALIB_VERSION
+    uint8_t reserved;
+    float dp_offset;                // Pa, subtracted from the raw samples
+    float dp_gain;
+    uint32_t check;                 // FNV-1a of the fields above
+} __attribute__((packed)) CalibRecord;
+
+typedef enum {
+    CALIB_OK,
+    CALIB_FAN_RUNNING,              // tare refused, the fan inverter reports running
+    CALIB_TARE_TIMEOUT,             // the SDP3x samples were not acquired
+    CALIB_NO_SD,
+    CALIB_FILE_ERROR,               // missing, invalid or not written
+} CalibStatus;
+
+/**
+ * Start the calibration thread: it loads the stored calibration once the
+ * SD card is there and runs the tare requests.
+ */
+void startCalibration(tprio_t prio);
+
+/**
+ * Tare with TARE_SAMPLES samples on the calibration thread, returns at once.
+ * Errors are traced. A request made while a tare runs starts another one.
+ */
+void requestTare();
+
+/**
+ * Apply the calibration stored on the SD card, waits for the card up to 500ms.
+ * The samples stay uncalibrated if there is none. Nothing is loaded once a
+ * calibration was applied, the stored one is then older.
+ */
+CalibStatus loadCalibration();
+
+/**
+ * Measure the offset with `nb_samples` samples, apply and save it.
+ * Blocks for the duration of the measurement.
+ * The new offset is applied even if it could not be saved.
+ */
+CalibStatus tareDp(uint16_t nb_samples);
+
+/**
+ * Apply and save the gain, the offset is kept.
+ */
+CalibStatus setDpGain(float gain);
+
+/**
+ * Back to uncalibrated samples (offset 0, gain 1), saved.
+ */
+CalibStatus clearCalibration();
+
+const char* calibStatusString(CalibStatus status);
+void printCalibration(BaseSequentialStream* lchp);
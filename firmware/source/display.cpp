@@ -1,5 +1,14 @@
 #include "display.h"
 #include "display4DS.h"
+#include "display_queue.h"
+#include "display_renderer.h"
+#include "display_chart.h"
+#include "fixed_format.h"
+#include "menu.h"
+#include "encoder.h"
+#include "touch.h"
+#include "calib.h"
+#include <string.h>
 #include "sensors.h"
 #include "sd.h"
 #include "stdutil++.hpp"
@@ -19,12 +28,7 @@
 #define GRAY_16b fds_colorDecTo16b(20, 20, 20)
 #define BLACK_16b fds_colorDecTo16b(0, 0, 0)
 #define WHITE_16b fds_colorDecTo16b(100, 100, 100)
-
-
-#define NOTOUCH 0
-#define TOUCH_PRESSED 1
-#define TOUCH_RELEASED 2
-#define TOUCH_MOVING 3
+#define CYAN_16b fds_colorDecTo16b(0, 100, 100)
 
 #define SD_X 230
 #define SD_Y 10
@@ -61,6 +65,31 @@ uint16_t VSD_Y[] = {
 #define USS_LOG_X 200
 #define USS_LOG_Y 10
 
+static void toggleLogging();
+static void nextPage();
+static void tare();
+
+// top left corner, left of the status icons
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static const TouchButton buttons[] = {
+    {.x1 = 0, .y1 = 0, .x2 = 44, .y2 = 18, .pages = TOUCH_ALL_PAGES, .handler = toggleLogging},
+    {.x1 = 50, .y1 = 0, .x2 = 94, .y2 = 18, .pages = TOUCH_ALL_PAGES, .handler = nextPage},
+    {.x1 = 100, .y1 = 0, .x2 = 144, .y2 = 18, .pages = TOUCH_ALL_PAGES, .handler = tare},
+};
+#pragma GCC diagnostic pop
+static const char* const button_labels[] = {"LOG", "PAGE", "TARE"};
+#define BUTTON_NB (sizeof(buttons)/sizeof(buttons[0]))
+
+// the table at the bottom of the screen has one page per set of values
+#define PAGE_NB 2
+#define TABLE_ROWS 4
+
+static const char* const table_labels[PAGE_NB][TABLE_ROWS][2] = {
+    {{"  tunnel", "    temp"}, {"   diff.", "pressure"}, {"   board", "    temp"}, {"absolute", "pressure"}},
+    {{"  tunnel", "humidity"}, {"     air", " density"}, {"     raw", "  diff p"}, {"     fan", "setpoint"}},
+};
+
 static void drawLayout(FdsDriver* fds) {
     fdsSetTextSizeMultiplier(fds, 1, 1);
     fdsDrawLine(fds, 0, 120,  240, 120,  2);
@@ -71,167 +100,296 @@ static void drawLayout(FdsDriver* fds) {
     fdsDrawLine(fds, 72, 120, 72, 240, 2);
 
     //gfx_button(fds, 0, 20, 10, fds_colorDecTo16b(50, 50, 200), fds_colorDecTo16b(100, 100, 100), 0, 1, 1, "test");
-    
-    gfx_moveTo(fds, 0, 125);
-    txt_putStr(fds, "  tunnel", NULL);
-    gfx_moveTo(fds, 0, 135);
-    txt_putStr(fds, "    temp", NULL);
-    gfx_moveTo(fds, 0, 155);
-    txt_putStr(fds, "   diff.", NULL);
-    gfx_moveTo(fds, 0, 165);
-    txt_putStr(fds, "pressure", NULL);
-    gfx_moveTo(fds, 0, 185);
-    txt_putStr(fds, "   board", NULL);
-    gfx_moveTo(fds, 0, 195);
-    txt_putStr(fds, "    temp", NULL);
-    gfx_moveTo(fds, 0, 215);
-    txt_putStr(fds, "absolute", NULL);
-    gfx_moveTo(fds, 0, 225);
-    txt_putStr(fds, "pressure", NULL);
-    
-}
 
-void drawLoggingStatus(FdsDriver* fds, uint16_t x, uint16_t y, uint16_t color, bool status) {
-    gfx_rectangleFilled(fds, x-4, y-4, x+4, y+4, BLACK_16b);
-    if(status) {
-        gfx_circleFilled(fds, x, y, 4, color);
-    } else {
-        gfx_circle(fds, x, y, 4, color);
-        // if(!isCardInserted()) {
-        //     gfx_line(fds,x-4, y-4, x+4, y+4, WHITE_16b);
-        //     gfx_line(fds,x-4, y+4, x+4, y-4, WHITE_16b);
-        // }
+    for(size_t i=0; i<BUTTON_NB; i++) {
+        const TouchButton* b = &buttons[i];
+        gfx_line(fds, b->x1, b->y1, b->x2, b->y1, WHITE_16b);
+        gfx_line(fds, b->x2, b->y1, b->x2, b->y2, WHITE_16b);
+        gfx_line(fds, b->x2, b->y2, b->x1, b->y2, WHITE_16b);
+        gfx_line(fds, b->x1, b->y2, b->x1, b->y1, WHITE_16b);
+        // label centered, font 8x8 at size 1
+        const uint16_t len = strlen(button_labels[i]);
+        gfx_moveTo(fds, (b->x1 + b->x2 + 1 - len * FONT_W) / 2, (b->y1 + b->y2 + 1 - 8) / 2);
+        txt_putStr(fds, button_labels[i], NULL);
     }
 }
 
-static THD_WORKING_AREA(waDisplay, 1024);
-void displayThd(void*) {
-    chRegSetThreadName("display");
+static void drawLoggingStatus(uint16_t x, uint16_t y, uint16_t color, bool status) {
+    displayRectangleFilled(x-4, y-4, x+4, y+4, BLACK_16b);
+    displayCircle(x, y, 4, color, status);
+}
 
-    char buffer[15];
+static void drawSdIcon(bool inserted) {
+    displayRectangleFilled(SD_X-4, SD_Y-4, SD_X+4, SD_Y+4, BLACK_16b);
+    displayPolygon(GRPH_SD_LEN-1, VSD_X, VSD_Y, WHITE_16b, inserted);
+    if(!inserted) {
+        displayLine(SD_X-4, SD_Y-4, SD_X+4, SD_Y+4, WHITE_16b);
+        displayLine(SD_X-4, SD_Y+4, SD_X+4, SD_Y-4, WHITE_16b);
+    }
+    // fdsDrawPolyLine(&fds, GRPH_SD_LEN, GRPH_SD, 3);
+}
 
-    FdsDriver fds;
-    fdsStart(&fds, &SD2, 300000, LINE_LCD_RESET, FDS_PIXXI);
-    fdsEnableTouch(&fds, true);
+/**
+ * Called by the display writer thread before it processes the commands.
+ */
+static void displaySetup(FdsDriver* fds) {
+    fdsStart(fds, &SD2, 300000, LINE_LCD_RESET, FDS_PIXXI);
+    fdsEnableTouch(fds, true);
 
-    fdsSetTextFgColorTable(&fds, 1, RED);
-    fdsSetTextFgColorTable(&fds, 2, GREEN);
-    fdsSetTextFgColorTable(&fds, 3, WHITE);
-    fdsSetTextFgColorTable(&fds, 4, BLACK);
+    fdsSetTextFgColorTable(fds, 1, RED);
+    fdsSetTextFgColorTable(fds, 2, GREEN);
+    fdsSetTextFgColorTable(fds, 3, WHITE);
+    fdsSetTextFgColorTable(fds, 4, BLACK);
 
     chThdSleepMilliseconds(20);
-    drawLayout(&fds);
-    
-    fdsSetTextSizeMultiplier(&fds, 2, 2);
-    txt_fgColour(&fds,  WHITE_16b, NULL);
+    drawLayout(fds);
+}
 
-    systime_t last_touch_time = 0;
+// values refresh period, only the changed characters are sent
+#define DISPLAY_REFRESH_PERIOD TIME_MS2I(100)
 
-    while(true) {
+#define MENU_EVENT EVENT_MASK(0)
 
-        if(rtcntDiffNow(last_touch_time) > chTimeMS2I(200)) {
-            last_touch_time = chSysGetRealtimeCounterX();
-
-            float tunnel_temp = getTunnelTemp();
-            float temp = getTemp();
-            float pressure = getAbsolutePressure();
-            float diff_p = getDiffPressure();
-            float airspeed = getAirspeed();
-
-            fdsSetTextSizeMultiplier(&fds, 3, 3);
-            txt_fgColour(&fds,  YELLOW_16b, NULL);
-            chsnprintf(buffer, 11, "%6.2f m/s", airspeed);
-            gfx_moveTo(&fds, 0, 60);
-            txt_putStr(&fds, buffer, NULL);
-
-
-            fdsSetTextSizeMultiplier(&fds, 2, 2);
-            txt_fgColour(&fds,  WHITE_16b, NULL);
-
-            chsnprintf(buffer, 15, "  %6.2f C", tunnel_temp);
-            gfx_moveTo(&fds, 80, 125);
-            txt_putStr(&fds, buffer, NULL);
-
-            chsnprintf(buffer, 15, "%7.2f Pa", diff_p);
-            gfx_moveTo(&fds, 80, 155);
-            txt_putStr(&fds, buffer, NULL);
-            
-            chsnprintf(buffer, 15, "  %6.2f C", temp);
-            gfx_moveTo(&fds, 80, 185);
-            txt_putStr(&fds, buffer, NULL);
-            
-            chsnprintf(buffer, 15, "%6.1f hPa", pressure);
-            gfx_moveTo(&fds, 80, 215);
-            txt_putStr(&fds, buffer, NULL);
-            
-            gfx_rectangleFilled(&fds, SD_X-4, SD_Y-4, SD_X+4, SD_Y+4, BLACK_16b);
-            if(isCardInserted()) {
-                gfx_polygonFilled(&fds, GRPH_SD_LEN-1, VSD_X, VSD_Y, WHITE_16b);
-            } else {
-                gfx_polygon(&fds, GRPH_SD_LEN-1, VSD_X, VSD_Y, WHITE_16b);
-                gfx_line(&fds,SD_X-4, SD_Y-4, SD_X+4, SD_Y+4, WHITE_16b);
-                gfx_line(&fds,SD_X-4, SD_Y+4, SD_X+4, SD_Y-4, WHITE_16b);
-            }
-            // fdsDrawPolyLine(&fds, GRPH_SD_LEN, GRPH_SD, 3);
+static TextWidget airspeed_widget = {.x = 0, .y = 60, .size = 3, .color = YELLOW_16b, .drawn = ""};
+static TextWidget fan_widget = {.x = 0, .y = 98, .size = 2, .color = WHITE_16b, .drawn = ""};
+static TextWidget table_widgets[TABLE_ROWS] = {
+    {.x = 80, .y = 125, .size = 2, .color = WHITE_16b, .drawn = ""},
+    {.x = 80, .y = 155, .size = 2, .color = WHITE_16b, .drawn = ""},
+    {.x = 80, .y = 185, .size = 2, .color = WHITE_16b, .drawn = ""},
+    {.x = 80, .y = 215, .size = 2, .color = WHITE_16b, .drawn = ""},
+};
+static StateWidget page_widget = {.drawn = -1};
+static StateWidget sd_widget = {.drawn = -1};
+static StateWidget sd_log_widget = {.drawn = -1};
+static StateWidget uss_log_widget = {.drawn = -1};
+
+// one column per refresh: the chart spans 24 s
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static StripChart chart = {
+    .x = 0, .y = 20, .w = 240, .h = 36,
+    .bg_color = BLACK_16b,
+    .nb_series = 2,
+    .series = {
+        {.min = 0.0f, .max = 30.0f, .color = YELLOW_16b},     // airspeed, m/s
+        {.min = 0.0f, .max = 500.0f, .color = CYAN_16b},      // diff. pressure, Pa
+    },
+};
+#pragma GCC diagnostic pop
+
+// the menu replaces the chart while it is open
+static TextWidget menu_label_widget = {.x = 0, .y = 21, .size = 2, .color = WHITE_16b, .drawn = ""};
+static TextWidget menu_value_widget = {.x = 0, .y = 39, .size = 2, .color = YELLOW_16b, .drawn = ""};
+static bool menu_shown = false;
+
+static void refreshValues() {
+    // room for the longest fmtFloat output and a unit
+    char buffer[FMT_FIXED_MAX_LEN + 8];
+
+    SensorSample sample = getSensorSample();
+    float airspeed = getAirspeed(sample);
+
+    strcpy(fmtFloat(buffer, airspeed, 6, 2), " m/s");
+    textWidgetDraw(&airspeed_widget, buffer);
+
+    if(!menu_shown) {
+        const float chart_values[] = {airspeed, sample.diff_p};
+        chartPush(&chart, chart_values);
+    }
+
+    DriveState drive = getDriveState();
+    if(drive.valid) {
+        strcpy(buffer, "fan ");
+        strcpy(fmtFloat(buffer + 4, drive.actual, 5, 1), " Hz");
+    } else {
+        strcpy(buffer, "fan   --- Hz");
+    }
+    textWidgetDraw(&fan_widget, buffer);
+
+    const uint8_t page = touchGetPage();
+    if(stateWidgetChanged(&page_widget, page)) {
+        for(size_t i=0; i<TABLE_ROWS; i++) {
+            displayText(0, 125 + 30 * i, 1, WHITE_16b, table_labels[page][i][0]);
+            displayText(0, 135 + 30 * i, 1, WHITE_16b, table_labels[page][i][1]);
+            textWidgetInvalidate(&table_widgets[i]);
+        }
+    }
+
+    if(page == 0) {
+        strcpy(fmtFloat(buffer, sample.tunnel_temp, 8, 2), " C");
+        textWidgetDraw(&table_widgets[0], buffer);
+
+        strcpy(fmtFloat(buffer, sample.diff_p, 7, 2), " Pa");
+        textWidgetDraw(&table_widgets[1], buffer);
+
+        strcpy(fmtFloat(buffer, sample.temp, 8, 2), " C");
+        textWidgetDraw(&table_widgets[2], buffer);
+
+        strcpy(fmtFloat(buffer, sample.pressure, 6, 1), " hPa");
+        textWidgetDraw(&table_widgets[3], buffer);
+    } else {
+        strcpy(fmtFloat(buffer, sample.rh, 8, 2), " %");
+        textWidgetDraw(&table_widgets[0], buffer);
 
+        // 10 characters fit right of the labels, the font has no '³'
+        strcpy(fmtFloat(buffer, sample.air_density, 5, 3), "kg/m3");
+        textWidgetDraw(&table_widgets[1], buffer);
 
+        strcpy(fmtFloat(buffer, sample.diff_p_raw, 7, 2), " Pa");
+        textWidgetDraw(&table_widgets[2], buffer);
 
-            drawLoggingStatus(&fds, SD_LOG_X, SD_LOG_Y, RED_16b, isLoggingSensors());
-            drawLoggingStatus(&fds, USS_LOG_X, USS_LOG_Y, YELLOW_16b, isLoggingUSS());
+        if(drive.valid) {
+            strcpy(fmtFloat(buffer, drive.setpoint, 7, 2), " Hz");
+        } else {
+            strcpy(buffer, "    --- Hz");
+        }
+        textWidgetDraw(&table_widgets[3], buffer);
+    }
+
+    bool inserted = isCardInserted();
+    if(stateWidgetChanged(&sd_widget, inserted)) {
+        drawSdIcon(inserted);
+    }
+    bool sd_logging = isLoggingSensors();
+    if(stateWidgetChanged(&sd_log_widget, sd_logging)) {
+        drawLoggingStatus(SD_LOG_X, SD_LOG_Y, RED_16b, sd_logging);
+    }
+    bool uss_logging = isLoggingUSS();
+    if(stateWidgetChanged(&uss_log_widget, uss_logging)) {
+        drawLoggingStatus(USS_LOG_X, USS_LOG_Y, YELLOW_16b, uss_logging);
+    }
+}
+
+static void refreshMenu() {
+    MenuView view = menuGetView();
+    if(!view.active) {
+        if(menu_shown) {
+            menu_shown = false;
+            chartInit(&chart);
         }
+        return;
+    }
+    if(!menu_shown) {
+        menu_shown = true;
+        displayRectangleFilled(chart.x, chart.y, chart.x + chart.w - 1, chart.y + chart.h - 1, chart.bg_color);
+        textWidgetInvalidate(&menu_label_widget);
+        textWidgetInvalidate(&menu_value_widget);
+    }
+
+    char buffer[MENU_TEXT_LEN + 3];
+    textWidgetDraw(&menu_label_widget, view.label);
+    strcpy(buffer, view.editing ? "> " : "  ");
+    strcat(buffer, view.value);
+    textWidgetDraw(&menu_value_widget, buffer);
+}
+
+static THD_WORKING_AREA(waDisplay, 1024);
+void displayThd(void*) {
+    chRegSetThreadName("ui");
+
+    event_listener_t menu_listener;
+    chEvtRegisterMask(menuEventSource(), &menu_listener, MENU_EVENT);
+
+    chartInit(&chart);
 
+    systime_t last_refresh = chVTGetSystemTimeX() - DISPLAY_REFRESH_PERIOD;
 
-        switch (fdsTouchGetStatus(&fds))
-        {
-        case NOTOUCH:
-            /* code */
-            break;
-        case TOUCH_PRESSED:
-            gfx_circleFilled(&fds, 120, 10, 5, RED_16b);
-            break;
-        case TOUCH_RELEASED:
-            gfx_circleFilled(&fds, 120, 10, 5, GRAY_16b);
-            break;
-        case TOUCH_MOVING:
-            /* code */
-            break;
+    while(true) {
+        sysinterval_t elapsed = chVTTimeElapsedSinceX(last_refresh);
+        if(elapsed >= DISPLAY_REFRESH_PERIOD) {
+            last_refresh = chVTGetSystemTimeX();
+            refreshValues();
+            elapsed = 0;
+        }
+
+        eventmask_t evt = chEvtWaitAnyTimeout(MENU_EVENT, DISPLAY_REFRESH_PERIOD - elapsed);
+        if(evt & MENU_EVENT) {
+            refreshMenu();
         }
-        
+    }
+}
+
+
+#define ENCODER_POLL_PERIOD TIME_MS2I(10)
+#define LONG_PRESS_TIME TIME_MS2I(1000)
+
+// called by the encoder and the touch threads
+static MUTEX_DECL(log_mtx);
+
+static void toggleLogging() {
+    chMtxLock(&log_mtx);
+    if(isLoggingSensors() || isLoggingUSS()) {
+        stopSensorLog();
+        stopUSSLog();
+        stopSdLog();
+    } else {
+        startSensorLog();
+        startUSSLog();
 
-        chThdSleepMilliseconds(5);
+        if(isLoggingSensors() && isLoggingUSS()) {
+            palToggleLine(LINE_LED2);
+        }
     }
+    chMtxUnlock(&log_mtx);
 }
 
+static void nextPage() {
+    touchSetPage((touchGetPage() + 1) % PAGE_NB);
+}
+
+static void tare() {
+    // about 2s of samples, the touch thread does not wait for them
+    requestTare();
+}
 
 static THD_WORKING_AREA(waEncoderThd, 4096);
 void encoderThd(void*) {
     chRegSetThreadName("encoder");
-    palEnableLineEvent(LINE_ENC_PUSH, PAL_EVENT_MODE_FALLING_EDGE);
+    encoderStart();
 
-    bool log_state = false;
+    uint16_t last_count = encoderGetCount();
+    bool pressed = false;
+    bool long_press = false;
+    systime_t press_start = 0;
 
     while(true) {
-        palWaitLineTimeout(LINE_ENC_PUSH, TIME_INFINITE);
-        if(log_state) {
-            stopSensorLog();
-            stopUSSLog();
-            stopSdLog();
-        } else {
-            startSensorLog();
-            startUSSLog();
-
-            if(isLoggingSensors() && isLoggingUSS()) {
-                palToggleLine(LINE_LED2);
+        chThdSleep(ENCODER_POLL_PERIOD);
+
+        // the remainder of a partial detent is kept for the next poll
+        const int32_t steps = (int16_t)(encoderGetCount() - last_count) / ENCODER_COUNTS_PER_DETENT;
+        last_count += steps * ENCODER_COUNTS_PER_DETENT;
+        menuTurn(steps);
+
+        // the push button pulls the line low, polling debounces it
+        const bool down = palReadLine(LINE_ENC_PUSH) == PAL_LOW;
+        if(down && !pressed) {
+            pressed = true;
+            long_press = false;
+            press_start = chVTGetSystemTimeX();
+        } else if(down && !long_press && chVTTimeElapsedSinceX(press_start) >= LONG_PRESS_TIME) {
+            long_press = true;
+            if(menuIsActive()) {
+                menuClose();
+            } else {
+                menuOpen();
+            }
+        } else if(!down && pressed) {
+            pressed = false;
+            // a long press is handled while the button is held
+            if(!long_press) {
+                if(menuIsActive()) {
+                    menuPress();
+                } else {
+                    toggleLogging();
+                }
             }
-            
-            
         }
-        log_state = isLoggingSensors() || isLoggingUSS();
-        chThdSleepMilliseconds(50);
     }
 }
 
 void startUI() {
-    chThdCreateStatic(waDisplay, sizeof(waDisplay), NORMALPRIO + 1, displayThd, NULL);
+    displayQueueStart(NORMALPRIO + 1, displaySetup);
+    chThdCreateStatic(waDisplay, sizeof(waDisplay), NORMALPRIO, displayThd, NULL);
     chThdCreateStatic(waEncoderThd, sizeof(waEncoderThd), NORMALPRIO + 1, encoderThd, NULL);
+    touchStart(NORMALPRIO, buttons, BUTTON_NB);
 }
\ No newline at end of file
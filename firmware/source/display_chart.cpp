@@ -0,0 +1,59 @@
+#include "display_chart.h"
+
+static uint8_t valueToRow(const StripChart* c, const ChartSeries* s, float v) {
+    float ratio = (v - s->min) / (s->max - s->min);
+    if(!(ratio > 0.0f)) {       // also catches NaN
+        ratio = 0.0f;
+    } else if(ratio > 1.0f) {
+        ratio = 1.0f;
+    }
+    return (uint8_t)((c->h - 1) * (1.0f - ratio) + 0.5f);
+}
+
+static void blankColumn(const StripChart* c, uint16_t col) {
+    displayLine(c->x + col, c->y, c->x + col, c->y + c->h - 1, c->bg_color);
+}
+
+/**
+ * Draw column `col` of every series: a vertical segment from the previous
+ * sample row to the sample row, so that consecutive samples are connected.
+ */
+static void drawColumn(const StripChart* c, uint16_t col, bool first) {
+    const uint16_t prev = col == 0 ? c->w - 1 : col - 1;
+    for(uint8_t i=0; i<c->nb_series; i++) {
+        const uint8_t row = c->ring[i][col];
+        const uint8_t from = first ? row : c->ring[i][prev];
+        displayLine(c->x + col, c->y + from, c->x + col, c->y + row, c->series[i].color);
+    }
+}
+
+void chartInit(StripChart* c) {
+    if(c->w > CHART_MAX_WIDTH) {
+        c->w = CHART_MAX_WIDTH;
+    }
+    if(c->nb_series > CHART_MAX_SERIES) {
+        c->nb_series = CHART_MAX_SERIES;
+    }
+    c->head = 0;
+    c->count = 0;
+    displayRectangleFilled(c->x, c->y, c->x + c->w - 1, c->y + c->h - 1, c->bg_color);
+}
+
+void chartPush(StripChart* c, const float* values) {
+    const uint16_t col = c->head;
+    for(uint8_t i=0; i<c->nb_series; i++) {
+        c->ring[i][col] = valueToRow(c, &c->series[i], values[i]);
+    }
+    // the column is blank: cleared by chartInit, or the gap of the last push.
+    // The left edge is not connected to the right edge.
+    drawColumn(c, col, col == 0);
+
+    c->head = (col + 1) % c->w;
+    if(c->count < c->w) {
+        c->count++;
+    }
+    // gap in front of the sweep
+    if(c->count == c->w) {
+        blankColumn(c, c->head);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "display_queue.h"
+
+// Strip chart in sweep mode: the samples are plotted from left to right, one
+// column per sample, and wrap around when the right edge is reached.
+// Each new sample only redraws its own column and blanks the next one, which
+// shows where the sweep is. The plotted rows of the last `w` samples are kept
+// in a ring buffer.
+
+#define CHART_MAX_SERIES 2
+#define CHART_MAX_WIDTH 240
+
+typedef struct {
+    float min;                  // value at the bottom row
+    float max;                  // value at the top row
+    uint16_t color;
+} ChartSeries;
+
+typedef struct {
+    uint16_t x;                 // top left corner
+    uint16_t y;
+    uint16_t w;                 // in pixels, at most CHART_MAX_WIDTH
+    uint16_t h;                 // in pixels, at most 255
+    uint16_t bg_color;
+    uint8_t nb_series;
+    ChartSeries series[CHART_MAX_SERIES];
+
+    uint8_t ring[CHART_MAX_SERIES][CHART_MAX_WIDTH];   // plotted row, from the top
+    uint16_t head;              // column of the next sample
+    uint16_t count;             // columns plotted
+} StripChart;
+
+/**
+ * Reset the samples and clear the chart area.
+ */
+void chartInit(StripChart* c);
+
+/**
+ * Plot one sample of each series, `values` has `nb_series` elements.
+ */
+void chartPush(StripChart* c, const float* values);
@@ -0,0 +1,231 @@
+#include "display_queue.h"
+#include <string.h>
+#include "printf.h"
+
+#define NOTOUCH 0
+#define TOUCH_PRESSED 1
+#define TOUCH_RELEASED 2
+#define TOUCH_MOVING 3
+
+typedef struct {
+    uint32_t commands;              // commands executed
+    uint32_t max_pending;           // highest number of queued commands
+    uint32_t touch_events;
+    uint32_t touch_polls;
+} DisplayQueueStats;
+
+static DisplayCmd queue_buffer[DISPLAY_QUEUE_LEN];
+static msg_t queue_msgs[DISPLAY_QUEUE_LEN];
+static objects_fifo_t queue;
+static EVENTSOURCE_DECL(touch_event);
+static DisplayTouchPoint touch_point = {};
+static DisplayQueueStats stats = {};
+static uint32_t pending = 0;
+
+// only used by the writer thread
+static FdsDriver fds;
+static void (*setup_cb)(FdsDriver* fds);
+static uint8_t text_size;           // text size multiplier last set, 0 if unknown
+static uint16_t text_color;
+static bool text_color_valid;
+
+static void setTextAttributes(uint8_t size, uint16_t color) {
+    if(text_size != size) {
+        fdsSetTextSizeMultiplier(&fds, size, size);
+        text_size = size;
+    }
+    if(!text_color_valid || text_color != color) {
+        txt_fgColour(&fds, color, NULL);
+        text_color = color;
+        text_color_valid = true;
+    }
+}
+
+static void execute(const DisplayCmd* cmd) {
+    switch (cmd->type)
+    {
+    case DISPLAY_CMD_TEXT:
+        setTextAttributes(cmd->text.size, cmd->color);
+        gfx_moveTo(&fds, cmd->text.x, cmd->text.y);
+        txt_putStr(&fds, cmd->text.str, NULL);
+        break;
+    case DISPLAY_CMD_LINE:
+        gfx_line(&fds, cmd->line.x1, cmd->line.y1, cmd->line.x2, cmd->line.y2, cmd->color);
+        break;
+    case DISPLAY_CMD_RECT_FILLED:
+        gfx_rectangleFilled(&fds, cmd->line.x1, cmd->line.y1, cmd->line.x2, cmd->line.y2, cmd->color);
+        break;
+    case DISPLAY_CMD_CIRCLE:
+        gfx_circle(&fds, cmd->circle.x, cmd->circle.y, cmd->circle.r, cmd->color);
+        break;
+    case DISPLAY_CMD_CIRCLE_FILLED:
+        gfx_circleFilled(&fds, cmd->circle.x, cmd->circle.y, cmd->circle.r, cmd->color);
+        break;
+    case DISPLAY_CMD_POLYGON:
+        gfx_polygon(&fds, cmd->polygon.n, cmd->polygon.vx, cmd->polygon.vy, cmd->color);
+        break;
+    case DISPLAY_CMD_POLYGON_FILLED:
+        gfx_polygonFilled(&fds, cmd->polygon.n, cmd->polygon.vx, cmd->polygon.vy, cmd->color);
+        break;
+    }
+}
+
+/**
+ * @return true if the screen is touched
+ */
+static bool pollTouch() {
+    eventflags_t flags = 0;
+    const uint16_t status = fdsTouchGetStatus(&fds);
+    switch (status)
+    {
+    case TOUCH_PRESSED:
+        flags = DISPLAY_TOUCH_PRESSED;
+        break;
+    case TOUCH_RELEASED:
+        flags = DISPLAY_TOUCH_RELEASED;
+        break;
+    case TOUCH_MOVING:
+        flags = DISPLAY_TOUCH_MOVING;
+        break;
+    case NOTOUCH:
+    default:
+        break;
+    }
+    if(flags & (DISPLAY_TOUCH_PRESSED | DISPLAY_TOUCH_MOVING)) {
+        // coordinates are only read while touched, they are two more round trips
+        DisplayTouchPoint p;
+        p.x = fdsTouchGetXcoord(&fds);
+        p.y = fdsTouchGetYcoord(&fds);
+        p.time = chVTGetSystemTimeX();
+        chSysLock();
+        touch_point = p;
+        chSysUnlock();
+    }
+    stats.touch_polls++;
+    if(flags) {
+        stats.touch_events++;
+        chEvtBroadcastFlags(&touch_event, flags);
+    }
+    return status == TOUCH_PRESSED || status == TOUCH_MOVING;
+}
+
+static THD_WORKING_AREA(waDisplayWriter, 1024);
+static void displayWriterThd(void*) {
+    chRegSetThreadName("display");
+
+    setup_cb(&fds);
+    // the setup drew directly, the text attributes are unknown
+    text_size = 0;
+    text_color_valid = false;
+
+    systime_t last_poll = chVTGetSystemTimeX();
+    systime_t last_active = last_poll;
+
+    while(true) {
+        const sysinterval_t period = chVTTimeElapsedSinceX(last_active) < DISPLAY_TOUCH_IDLE_DELAY ?
+                                     DISPLAY_TOUCH_PERIOD_ACTIVE : DISPLAY_TOUCH_PERIOD_IDLE;
+        const sysinterval_t elapsed = chVTTimeElapsedSinceX(last_poll);
+        const sysinterval_t wait = elapsed >= period ? TIME_IMMEDIATE : period - elapsed;
+
+        DisplayCmd* cmd;
+        if(chFifoReceiveObjectTimeout(&queue, (void**)&cmd, wait) == MSG_OK) {
+            execute(cmd);
+            chFifoReturnObject(&queue, cmd);
+            chSysLock();
+            pending--;
+            stats.commands++;
+            chSysUnlock();
+        }
+
+        // touch is polled between commands, whatever the queue length
+        if(chVTTimeElapsedSinceX(last_poll) >= period) {
+            last_poll = chVTGetSystemTimeX();
+            if(pollTouch()) {
+                last_active = last_poll;
+            }
+        }
+    }
+}
+
+void displayQueueStart(tprio_t prio, void (*setup)(FdsDriver* fds)) {
+    chFifoObjectInit(&queue, sizeof(DisplayCmd), DISPLAY_QUEUE_LEN, queue_buffer, queue_msgs);
+    setup_cb = setup;
+    chThdCreateStatic(waDisplayWriter, sizeof(waDisplayWriter), prio, displayWriterThd, NULL);
+}
+
+void displayPost(const DisplayCmd* cmd) {
+    DisplayCmd* slot = (DisplayCmd*)chFifoTakeObjectTimeout(&queue, TIME_INFINITE);
+    *slot = *cmd;
+    chSysLock();
+    pending++;
+    if(pending > stats.max_pending) {
+        stats.max_pending = pending;
+    }
+    chSysUnlock();
+    chFifoSendObject(&queue, slot);
+}
+
+void displayText(uint16_t x, uint16_t y, uint8_t size, uint16_t color, const char* str) {
+    DisplayCmd cmd;
+    cmd.type = DISPLAY_CMD_TEXT;
+    cmd.color = color;
+    cmd.text.x = x;
+    cmd.text.y = y;
+    cmd.text.size = size;
+    strncpy(cmd.text.str, str, DISPLAY_TEXT_LEN);
+    cmd.text.str[DISPLAY_TEXT_LEN] = '\0';
+    displayPost(&cmd);
+}
+
+void displayLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color) {
+    DisplayCmd cmd;
+    cmd.type = DISPLAY_CMD_LINE;
+    cmd.color = color;
+    cmd.line = {x1, y1, x2, y2};
+    displayPost(&cmd);
+}
+
+void displayRectangleFilled(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color) {
+    DisplayCmd cmd;
+    cmd.type = DISPLAY_CMD_RECT_FILLED;
+    cmd.color = color;
+    cmd.line = {x1, y1, x2, y2};
+    displayPost(&cmd);
+}
+
+void displayCircle(uint16_t x, uint16_t y, uint16_t r, uint16_t color, bool filled) {
+    DisplayCmd cmd;
+    cmd.type = filled ? DISPLAY_CMD_CIRCLE_FILLED : DISPLAY_CMD_CIRCLE;
+    cmd.color = color;
+    cmd.circle = {x, y, r};
+    displayPost(&cmd);
+}
+
+void displayPolygon(uint16_t n, uint16_t* vx, uint16_t* vy, uint16_t color, bool filled) {
+    DisplayCmd cmd;
+    cmd.type = filled ? DISPLAY_CMD_POLYGON_FILLED : DISPLAY_CMD_POLYGON;
+    cmd.color = color;
+    cmd.polygon = {n, vx, vy};
+    displayPost(&cmd);
+}
+
+event_source_t* displayTouchEventSource() {
+    return &touch_event;
+}
+
+DisplayTouchPoint displayGetTouchPoint() {
+    chSysLock();
+    DisplayTouchPoint p = touch_point;
+    chSysUnlock();
+    return p;
+}
+
+void printDisplayStats(BaseSequentialStream* lchp) {
+    chSysLock();
+    DisplayQueueStats s = stats;
+    uint32_t p = pending;
+    chSysUnlock();
+    chprintf(lchp, "display commands: %lu, pending %lu, max pending %lu/%u\r\n",
+             s.commands, p, s.max_pending, DISPLAY_QUEUE_LEN);
+    chprintf(lchp, "touch events: %lu, polls %lu\r\n", s.touch_events, s.touch_polls);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "ch.h"
+#include "hal.h"
+#include "display4DS.h"
+
+// Display command queue
+// Each display4DS call is a blocking round trip to the display: they are only
+// made by the display writer thread, which owns the FdsDriver. Other threads
+// post drawing commands to a bounded FIFO, drained by the writer in order.
+// The writer polls the touch screen between commands, status changes are
+// broadcast on the touch event source. Polling is fast while the screen is
+// touched, and slows down once it has been idle for a while.
+
+#define DISPLAY_QUEUE_LEN 32
+#define DISPLAY_TEXT_LEN 16             // longest text of a single command
+#define DISPLAY_TOUCH_PERIOD_ACTIVE TIME_MS2I(10)
+#define DISPLAY_TOUCH_PERIOD_IDLE TIME_MS2I(50)
+#define DISPLAY_TOUCH_IDLE_DELAY TIME_MS2I(1000)     // without touch before polling slows down
+
+// touch event flags
+#define DISPLAY_TOUCH_PRESSED (1 << 0)
+#define DISPLAY_TOUCH_RELEASED (1 << 1)
+#define DISPLAY_TOUCH_MOVING (1 << 2)
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    systime_t time;
+} DisplayTouchPoint;
+
+typedef enum {
+    DISPLAY_CMD_TEXT,
+    DISPLAY_CMD_LINE,
+    DISPLAY_CMD_RECT_FILLED,
+    DISPLAY_CMD_CIRCLE,
+    DISPLAY_CMD_CIRCLE_FILLED,
+    DISPLAY_CMD_POLYGON,
+    DISPLAY_CMD_POLYGON_FILLED,
+} DisplayCmdType;
+
+typedef struct {
+    DisplayCmdType type;
+    uint16_t color;
+    union {
+        struct {
+            uint16_t x;
+            uint16_t y;
+            uint8_t size;           // text size multiplier
+            char str[DISPLAY_TEXT_LEN + 1];
+        } text;
+        struct {
+            uint16_t x1;
+            uint16_t y1;
+            uint16_t x2;
+            uint16_t y2;
+        } line;                     // also the corners of rectangles
+        struct {
+            uint16_t x;
+            uint16_t y;
+            uint16_t r;
+        } circle;
+        struct {
+            uint16_t n;
+            uint16_t* vx;           // byte swapped coordinates, static storage
+            uint16_t* vy;
+        } polygon;
+    };
+} DisplayCmd;
+
+/**
+ * Start the display writer thread.
+ * `setup` is called by the writer thread once, before the commands are
+ * processed: it must start the driver and may draw directly on `fds`.
+ */
+void displayQueueStart(tprio_t prio, void (*setup)(FdsDriver* fds));
+
+/**
+ * Post a command, waiting for a free slot if the queue is full.
+ */
+void displayPost(const DisplayCmd* cmd);
+
+void displayText(uint16_t x, uint16_t y, uint8_t size, uint16_t color, const char* str);
+void displayLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
+void displayRectangleFilled(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
+void displayCircle(uint16_t x, uint16_t y, uint16_t r, uint16_t color, bool filled);
+void displayPolygon(uint16_t n, uint16_t* vx, uint16_t* vy, uint16_t color, bool filled);
+
+/**
+ * Touch status changes, flags are DISPLAY_TOUCH_*.
+ */
+event_source_t* displayTouchEventSource();
+
+/**
+ * Coordinates of the last pressed or moving status.
+ */
+DisplayTouchPoint displayGetTouchPoint();
+
+/**
+ * Print the command queue statistics.
+ */
+void printDisplayStats(BaseSequentialStream* lchp);
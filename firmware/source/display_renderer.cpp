@@ -0,0 +1,37 @@
+#include "display_renderer.h"
+#include <string.h>
+
+void textWidgetDraw(TextWidget* w, const char* text) {
+    char next[TEXT_WIDGET_LEN + 1];
+    strncpy(next, text, TEXT_WIDGET_LEN);
+    next[TEXT_WIDGET_LEN] = '\0';
+    size_t len = strlen(next);
+    const size_t drawn_len = strlen(w->drawn);
+    // blank the end of a longer previous text
+    while(len < drawn_len) {
+        next[len++] = ' ';
+    }
+    next[len] = '\0';
+
+    // post each run of changed characters
+    size_t i = 0;
+    while(i < len) {
+        if(i < drawn_len && next[i] == w->drawn[i]) {
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while(end < len && !(end < drawn_len && next[end] == w->drawn[end])) {
+            end++;
+        }
+        char run[TEXT_WIDGET_LEN + 1];
+        memcpy(run, next + i, end - i);
+        run[end - i] = '\0';
+
+        displayText(w->x + i * FONT_W * w->size, w->y, w->size, w->color, run);
+        i = end;
+    }
+
+    // trailing blanks are part of the screen content
+    memcpy(w->drawn, next, len + 1);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "display_queue.h"
+
+// Retained mode rendering: each widget keeps what was last drawn, and only the
+// changes are posted to the display command queue.
+// Text is drawn with an opaque background, so a character cell is redrawn
+// by writing the new character over it.
+
+#define FONT_W 8                // character width at text size 1, in pixels
+#define TEXT_WIDGET_LEN DISPLAY_TEXT_LEN
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint8_t size;               // text size multiplier
+    uint16_t color;
+    char drawn[TEXT_WIDGET_LEN + 1];    // text on screen, empty if not drawn yet
+} TextWidget;
+
+typedef struct {
+    int16_t drawn;              // state on screen, -1 if not drawn yet
+} StateWidget;
+
+/**
+ * Draw `text`, only sending the characters that differ from the text on screen.
+ * Longer texts are truncated to TEXT_WIDGET_LEN.
+ */
+void textWidgetDraw(TextWidget* w, const char* text);
+
+static inline void textWidgetInvalidate(TextWidget* w) {
+    w->drawn[0] = '\0';
+}
+
+/**
+ * @return true if `state` differs from the state on screen, which is then
+ * updated: the caller must redraw the widget.
+ */
+static inline bool stateWidgetChanged(StateWidget* w, int16_t state) {
+    if(w->drawn == state) {
+        return false;
+    }
+    w->drawn = state;
+    return true;
+}
+
+static inline void stateWidgetInvalidate(StateWidget* w) {
+    w->drawn = -1;
+}
@@ -0,0 +1,100 @@
+#include "dp_filter.h"
+#include "string.h"
+
+void dpFilterInit(DpFilter* f, const DpFilterConfig* config) {
+    memset(f, 0, sizeof(*f));
+    f->config = *config;
+    if(f->config.length < 1) {
+        f->config.length = 1;
+    } else if(f->config.length > DP_FILTER_MAX_LEN) {
+        f->config.length = DP_FILTER_MAX_LEN;
+    }
+    if(!(f->config.alpha > 0.0f) || f->config.alpha > 1.0f) {
+        f->config.alpha = 1.0f;
+    }
+    if(f->config.decimation < 1) {
+        f->config.decimation = 1;
+    }
+}
+
+static float movingAverage(DpFilter* f, float x) {
+    if(f->count == f->config.length) {
+        f->sum -= f->ring[f->head];
+    } else {
+        f->count++;
+    }
+    f->ring[f->head] = x;
+    f->sum += x;
+    f->head = (f->head + 1) % f->config.length;
+    if(f->head == 0) {
+        // recompute the sum once per window to cancel rounding drift
+        float sum = 0;
+        for(uint8_t i=0; i<f->count; i++) {
+            sum += f->ring[i];
+        }
+        f->sum = sum;
+    }
+    return f->sum / f->count;
+}
+
+static float median(DpFilter* f, float x) {
+    f->ring[f->head] = x;
+    f->head = (f->head + 1) % f->config.length;
+    if(f->count < f->config.length) {
+        f->count++;
+    }
+
+    // insertion sort of a copy, the window is small
+    float sorted[DP_FILTER_MAX_LEN];
+    for(uint8_t i=0; i<f->count; i++) {
+        float v = f->ring[i];
+        uint8_t j = i;
+        while(j > 0 && sorted[j-1] > v) {
+            sorted[j] = sorted[j-1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    if(f->count & 1) {
+        return sorted[f->count / 2];
+    }
+    return 0.5f * (sorted[f->count / 2 - 1] + sorted[f->count / 2]);
+}
+
+static float lowPass(DpFilter* f, float x) {
+    if(f->count == 0) {
+        f->state = x;
+        f->count = 1;
+    } else {
+        f->state += f->config.alpha * (x - f->state);
+    }
+    return f->state;
+}
+
+bool dpFilterPush(DpFilter* f, float x, float* out) {
+    float y;
+    switch (f->config.type)
+    {
+    case DP_FILTER_MOVING_AVERAGE:
+        y = movingAverage(f, x);
+        break;
+    case DP_FILTER_LOW_PASS:
+        y = lowPass(f, x);
+        break;
+    case DP_FILTER_MEDIAN:
+        y = median(f, x);
+        break;
+    case DP_FILTER_NONE:
+    default:
+        y = x;
+        break;
+    }
+
+    f->decim_count++;
+    if(f->decim_count >= f->config.decimation) {
+        f->decim_count = 0;
+        *out = y;
+        return true;
+    }
+    return false;
+}
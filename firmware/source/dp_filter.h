@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Streaming filter for the high rate differential pressure samples.
+// Fixed size ring buffer, no allocation. The filter runs on every input
+// sample, one filtered output is produced every `decimation` inputs.
+
+#define DP_FILTER_MAX_LEN 32
+
+typedef enum {
+    DP_FILTER_NONE,             // pass-through (still decimated)
+    DP_FILTER_MOVING_AVERAGE,   // mean of the last `length` samples
+    DP_FILTER_LOW_PASS,         // first order IIR: y += alpha * (x - y)
+    DP_FILTER_MEDIAN,           // median of the last `length` samples
+} DpFilterType;
+
+typedef struct {
+    DpFilterType type;
+    uint8_t length;         // window of the moving average and median filters, [1, DP_FILTER_MAX_LEN]
+    float alpha;            // low pass coefficient, ]0, 1]
+    uint8_t decimation;     // one output every `decimation` inputs, >= 1
+} DpFilterConfig;
+
+typedef struct {
+    DpFilterConfig config;
+    float ring[DP_FILTER_MAX_LEN];
+    uint8_t head;           // next write index
+    uint8_t count;          // number of samples in the ring
+    float sum;              // moving average running sum
+    float state;            // low pass output
+    uint8_t decim_count;
+} DpFilter;
+
+/**
+ * Reset the filter with a new configuration. Out of range parameters are clamped.
+ */
+void dpFilterInit(DpFilter* f, const DpFilterConfig* config);
+
+/**
+ * Feed one sample.
+ * @return true if a decimated output was written in `out`
+ */
+bool dpFilterPush(DpFilter* f, float x, float* out);
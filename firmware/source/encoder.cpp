@@ -0,0 +1,24 @@
+#include "encoder.h"
+#include "hal.h"
+extern "C" {
+    #include "quadEncoder.h"
+}
+
+// counts both edges of both inputs: ENCODER_COUNTS_PER_DETENT per detent
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static const QEIConfig qei_config = {
+    .mode = QEI_MODE_QUADRATURE,
+    .resolution = QEI_BOTH_EDGES,
+    .dirinv = QEI_DIRINV_FALSE,
+};
+#pragma GCC diagnostic pop
+
+void encoderStart() {
+    qeiStart(&QEID3, &qei_config);
+    qeiEnable(&QEID3);
+}
+
+uint16_t encoderGetCount() {
+    return (uint16_t)qeiGetCount(&QEID3);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+// Quadrature encoder on TIM3 (ENC_A on CH1, ENC_B on CH2, AF2), through the
+// QEI driver (various/quadEncoder.c): the timer counts the edges of both
+// channels in hardware.
+
+#define ENCODER_COUNTS_PER_DETENT 4
+
+void encoderStart();
+
+/**
+ * Raw counter, wraps at 16 bits: compute differences as int16_t.
+ */
+uint16_t encoderGetCount();
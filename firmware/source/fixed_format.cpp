@@ -0,0 +1,82 @@
+#include "fixed_format.h"
+#include <string.h>
+
+static const int32_t pow10i[FMT_FIXED_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000,
+};
+
+static char* padRight(char* dst, const char* src, uint8_t len, uint8_t width) {
+    while(width > len) {
+        *dst++ = ' ';
+        width--;
+    }
+    for(uint8_t i=0; i<len; i++) {
+        *dst++ = src[i];
+    }
+    *dst = '\0';
+    return dst;
+}
+
+// digits of mag / 10^decimals, sign first
+static char* formatScaled(char* dst, bool negative, uint32_t mag, uint8_t width, uint8_t decimals) {
+    // digits are produced from the right
+    char tmp[FMT_FIXED_MAX_LEN];
+    char* p = tmp + sizeof(tmp);
+    uint8_t digits = 0;
+    do {
+        *--p = '0' + mag % 10;
+        mag /= 10;
+        digits++;
+        if(digits == decimals) {
+            *--p = '.';
+        }
+    } while(mag != 0 || digits <= decimals);
+    if(negative) {
+        *--p = '-';
+    }
+    return padRight(dst, p, tmp + sizeof(tmp) - p, width);
+}
+
+char* fmtFixed(char* dst, int32_t value, uint8_t width, uint8_t decimals) {
+    if(decimals > FMT_FIXED_MAX_DECIMALS) {
+        decimals = FMT_FIXED_MAX_DECIMALS;
+    }
+    const uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    return formatScaled(dst, value < 0, mag, width, decimals);
+}
+
+char* fmtFloat(char* dst, float value, uint8_t width, uint8_t decimals) {
+    if(decimals > FMT_FIXED_MAX_DECIMALS) {
+        decimals = FMT_FIXED_MAX_DECIMALS;
+    }
+    // the scaled value must fit in an int32_t, also false for NaN
+    const float limit = 2.0e9f / pow10i[decimals];
+    if(!(value > -limit && value < limit)) {
+        return padRight(dst, "---", 3, width);
+    }
+    // value = mant * 2^exp exactly, and mant * 10^decimals fits in 44 bits:
+    // the scaled value is rounded exactly, half to even like printf
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t biased_exp = (bits >> 23) & 0xFF;
+    uint64_t mant = bits & 0x7FFFFF;
+    int32_t exp = -149;     // denormals
+    if(biased_exp != 0) {
+        mant |= 0x800000;
+        exp = (int32_t)biased_exp - 150;
+    }
+    const uint64_t scaled = mant * pow10i[decimals];
+    uint32_t mag = 0;
+    if(exp >= 0) {
+        mag = scaled << exp;
+    } else if(exp > -64) {
+        const uint64_t rem = scaled & ((1ULL << -exp) - 1);
+        const uint64_t half = 1ULL << (-exp - 1);
+        mag = scaled >> -exp;
+        if(rem > half || (rem == half && (mag & 1))) {
+            mag++;
+        }
+    }
+    // below 2^-64, the scaled value is far below one half: rounds to 0
+    return formatScaled(dst, bits >> 31, mag, width, decimals);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+
+// Number formatting without printf, for the display refresh.
+// The value is a scaled integer: `value / 10^decimals`. The output is right
+// aligned in at least `width` characters, like printf("%*.*f"), and wider if
+// the number does not fit.
+
+#define FMT_FIXED_MAX_DECIMALS 6
+// longest output for an int32_t: sign, 10 digits, point, NUL
+#define FMT_FIXED_MAX_LEN 13
+
+/**
+ * Write the formatted number in `dst`, which must hold
+ * max(width + 1, FMT_FIXED_MAX_LEN) bytes, the terminating NUL included.
+ * @return a pointer to the terminating NUL, to append units.
+ */
+char* fmtFixed(char* dst, int32_t value, uint8_t width, uint8_t decimals);
+
+/**
+ * Same as fmtFixed for a float, with the output of printf("%*.*f"):
+ * rounded half to even to `decimals`, and a minus sign for negative values
+ * that round to zero.
+ * Non finite values and values beyond 2e9 once scaled are written as "---".
+ */
+char* fmtFloat(char* dst, float value, uint8_t width, uint8_t decimals);
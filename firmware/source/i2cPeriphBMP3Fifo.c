@@ -0,0 +1,143 @@
+#include "i2cPeriphBMP3Fifo.h"
+#include "stdutil.h"
+#include <string.h>
+
+
+#define I2C_TIMOUT_100MS TIME_MS2I(100U)
+#define BMP3_WRITE_MAX_LEN 32
+
+static BMP3_INTF_RET_TYPE bmp3I2cRead(uint8_t reg_addr, uint8_t *read_data, uint32_t len, void *intf_ptr);
+static BMP3_INTF_RET_TYPE bmp3I2cWrite(uint8_t reg_addr, const uint8_t *data, uint32_t len, void *intf_ptr);
+static void bmp3DelayUs(uint32_t period, void *intf_ptr);
+
+
+msg_t bmp3FifoStart(Bmp3FifoDriver *bmpp, I2CDriver *i2cp, const uint8_t addr,
+                    const uint8_t odr, const uint8_t press_os, const uint8_t temp_os)
+{
+  bmpp->i2cp = i2cp;
+  bmpp->slaveAddr = addr;
+  bmpp->nb_frames = 0;
+
+  bmpp->dev.intf_ptr = bmpp;
+  bmpp->dev.intf = BMP3_I2C_INTF;
+  bmpp->dev.read = bmp3I2cRead;
+  bmpp->dev.write = bmp3I2cWrite;
+  bmpp->dev.delay_us = bmp3DelayUs;
+
+  if (bmp3_init(&bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  memset(&bmpp->settings, 0, sizeof(bmpp->settings));
+  bmpp->settings.press_en = BMP3_ENABLE;
+  bmpp->settings.temp_en = BMP3_ENABLE;
+  bmpp->settings.odr_filter.press_os = press_os;
+  bmpp->settings.odr_filter.temp_os = temp_os;
+  bmpp->settings.odr_filter.odr = odr;
+  if (bmp3_set_sensor_settings(BMP3_SEL_PRESS_EN | BMP3_SEL_TEMP_EN | BMP3_SEL_PRESS_OS |
+                               BMP3_SEL_TEMP_OS | BMP3_SEL_ODR,
+                               &bmpp->settings, &bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  memset(&bmpp->fifo_settings, 0, sizeof(bmpp->fifo_settings));
+  bmpp->fifo_settings.mode = BMP3_ENABLE;
+  bmpp->fifo_settings.press_en = BMP3_ENABLE;
+  bmpp->fifo_settings.temp_en = BMP3_ENABLE;
+  bmpp->fifo_settings.down_sampling = BMP3_FIFO_NO_SUBSAMPLING;
+  bmpp->fifo_settings.filter_en = BMP3_ENABLE;
+  if (bmp3_set_fifo_settings(BMP3_SEL_FIFO_MODE | BMP3_SEL_FIFO_PRESS_EN | BMP3_SEL_FIFO_TEMP_EN |
+                             BMP3_SEL_FIFO_DOWN_SAMPLING | BMP3_SEL_FIFO_FILTER_EN,
+                             &bmpp->fifo_settings, &bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  memset(&bmpp->fifo, 0, sizeof(bmpp->fifo));
+  bmpp->fifo.buffer = bmpp->buffer;
+
+  if (bmp3_fifo_flush(&bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  bmpp->settings.op_mode = BMP3_MODE_NORMAL;
+  if (bmp3_set_op_mode(&bmpp->settings, &bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  return MSG_OK;
+}
+
+
+msg_t bmp3FifoDrain(Bmp3FifoDriver *bmpp)
+{
+  bmpp->nb_frames = 0;
+
+  // FIFO length then the whole FIFO content in one burst
+  if (bmp3_get_fifo_data(&bmpp->fifo, &bmpp->fifo_settings, &bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  if (bmpp->fifo.byte_count == 0)
+    return MSG_OK;
+
+  if (bmp3_extract_fifo_data(bmpp->frames, &bmpp->fifo, &bmpp->dev) != BMP3_OK)
+    return MSG_RESET;
+
+  bmpp->nb_frames = bmpp->fifo.parsed_frames;
+  return MSG_OK;
+}
+
+
+uint32_t bmp3FifoFramePeriodUs(const Bmp3FifoDriver *bmpp)
+{
+  // BMP3_ODR_200_HZ is 0, each following code halves the rate
+  return 5000U << bmpp->settings.odr_filter.odr;
+}
+
+
+
+static BMP3_INTF_RET_TYPE bmp3I2cRead(uint8_t reg_addr, uint8_t *read_data, uint32_t len, void *intf_ptr)
+{
+  Bmp3FifoDriver *bmpp = (Bmp3FifoDriver *) intf_ptr;
+  const uint8_t CACHE_ALIGNED(reg) = reg_addr;
+
+#if I2C_USE_MUTUAL_EXCLUSION
+  i2cAcquireBus(bmpp->i2cp);
+#endif
+  const msg_t status = i2cMasterTransmitTimeout(bmpp->i2cp, bmpp->slaveAddr,
+						&reg, sizeof(reg), read_data, len,
+						I2C_TIMOUT_100MS);
+#if I2C_USE_MUTUAL_EXCLUSION
+  i2cReleaseBus(bmpp->i2cp);
+#endif
+
+  return status == MSG_OK ? BMP3_INTF_RET_SUCCESS : BMP3_E_COMM_FAIL;
+}
+
+
+static BMP3_INTF_RET_TYPE bmp3I2cWrite(uint8_t reg_addr, const uint8_t *data, uint32_t len, void *intf_ptr)
+{
+  Bmp3FifoDriver *bmpp = (Bmp3FifoDriver *) intf_ptr;
+  uint8_t CACHE_ALIGNED(txbuf[BMP3_WRITE_MAX_LEN + 1]);
+
+  if (len > BMP3_WRITE_MAX_LEN)
+    return BMP3_E_INVALID_LEN;
+
+  // register address followed by data (already interleaved by bmp3_set_regs)
+  txbuf[0] = reg_addr;
+  memcpy(&txbuf[1], data, len);
+
+#if I2C_USE_MUTUAL_EXCLUSION
+  i2cAcquireBus(bmpp->i2cp);
+#endif
+  const msg_t status = i2cMasterTransmitTimeout(bmpp->i2cp, bmpp->slaveAddr,
+						txbuf, len + 1, NULL, 0,
+						I2C_TIMOUT_100MS);
+#if I2C_USE_MUTUAL_EXCLUSION
+  i2cReleaseBus(bmpp->i2cp);
+#endif
+
+  return status == MSG_OK ? BMP3_INTF_RET_SUCCESS : BMP3_E_COMM_FAIL;
+}
+
+
+static void bmp3DelayUs(uint32_t period, void *intf_ptr)
+{
+  (void) intf_ptr;
+  const sysinterval_t ticks = TIME_US2I(period);
+  chThdSleep(ticks > 0 ? ticks : 1);
+}
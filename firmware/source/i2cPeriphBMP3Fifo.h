@@ -0,0 +1,64 @@
+#pragma once
+#include "hal.h"
+#include "bmp3.h"
+
+
+/**
+ * @name    FIFO buffer size
+ * @brief   whole BMP3 FIFO plus the sensor time frame overhead
+ * @{
+ */
+#define BMP3_FIFO_BUFFER_SIZE (512 + 4)
+/** @} */
+
+
+/**
+ * @name    handler of driver
+ * @brief   BMP3 in normal mode with the hardware FIFO enabled,
+ *          temperature and pressure frames, no sensor time.
+ * @note    must be placed in a DMA capable section (IN_DMA_SECTION),
+ *          and used from a thread whose stack is DMA capable.
+ * @{
+ */
+typedef struct Bmp3FifoDriver Bmp3FifoDriver; /**< @brief  opaque type */
+/** @} */
+
+struct Bmp3FifoDriver {
+  I2CDriver    *i2cp;
+  uint8_t       slaveAddr;
+  struct bmp3_dev dev;
+  struct bmp3_settings settings;
+  struct bmp3_fifo_settings fifo_settings;
+  struct bmp3_fifo_data fifo;
+  uint8_t       buffer[BMP3_FIFO_BUFFER_SIZE];
+  struct bmp3_data frames[BMP3_FIFO_MAX_FRAMES];  /**< @brief  frames of the last drain, oldest first  */
+  uint8_t       nb_frames;                        /**< @brief  number of valid frames   */
+};
+
+/**
+ * @brief   reset and configure the sensor, then enable its FIFO
+ * @param[in] odr           BMP3_ODR_xxx
+ * @param[in] press_os      BMP3_OVERSAMPLING_xxx, must fit in the ODR period
+ * @param[in] temp_os       BMP3_OVERSAMPLING_xxx, must fit in the ODR period
+ */
+msg_t bmp3FifoStart(Bmp3FifoDriver *bmpp, I2CDriver *i2cp, const uint8_t addr,
+                    const uint8_t odr, const uint8_t press_os, const uint8_t temp_os);
+
+/**
+ * @brief   read the whole FIFO in one burst and compensate every frame
+ * @details frames are in bmpp->frames[0 .. bmpp->nb_frames[
+ */
+msg_t bmp3FifoDrain(Bmp3FifoDriver *bmpp);
+
+/**
+ * @brief   time between two frames, in microseconds
+ */
+uint32_t bmp3FifoFramePeriodUs(const Bmp3FifoDriver *bmpp);
+
+static inline float bmp3FifoGetTemp(const Bmp3FifoDriver *bmpp, const uint8_t frame) {
+  return (float) bmpp->frames[frame].temperature;
+}
+
+static inline float bmp3FifoGetPressure(const Bmp3FifoDriver *bmpp, const uint8_t frame) {
+  return (float) bmpp->frames[frame].pressure;
+}
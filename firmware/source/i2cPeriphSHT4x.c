@@ -108,10 +108,10 @@ msg_t  sht4xFetch(Sht4xDriver *shtp)
     default:
     {
         uint16_t st = __builtin_bswap16(*(uint16_t*)data.data_atom[0].data);
-        uint16_t srh = __builtin_bswap16(*(uint16_t*)data.data_atom[0].data);
+        uint16_t srh = __builtin_bswap16(*(uint16_t*)data.data_atom[1].data);
 
-        shtp->temp = -45.0 + 175.0*st/((float)((1<<16) - 1));
-        shtp->rh = -6.0 + 125.0*srh/((float)((1<<16) - 1));
+        shtp->temp = sht4xRawToTemp(st);
+        shtp->rh = sht4xRawToRH(srh);
     }
     break;
   }
@@ -78,6 +78,17 @@ msg_t sht4xSend(Sht4xDriver *shtp, const Sht4xCommand cmd);
 msg_t  sht4xFetch(Sht4xDriver *shtp);
 
 
+/**
+ * @brief   convert raw measurement words, in single precision
+ */
+static inline float sht4xRawToTemp(const uint16_t st) {
+    return -45.0f + 175.0f * (float) st * (1.0f / 65535.0f);
+}
+
+static inline float sht4xRawToRH(const uint16_t srh) {
+    return -6.0f + 125.0f * (float) srh * (1.0f / 65535.0f);
+}
+
 static inline float sht4xGetTemp(Sht4xDriver *shtp) {
     return shtp->temp;
 }
@@ -22,6 +22,7 @@
 #include "sd.h"
 #include "ttyConsole.h"
 #include "uss_handler.h"
+#include "calib.h"
 
 
 SerialConfig sd6_conf = {
@@ -68,6 +69,7 @@ int main(void) {
 
   consoleInit();
   startSensors();
+  startCalibration(NORMALPRIO);
   startUSSListener();
   startUI();
   
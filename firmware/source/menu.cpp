@@ -0,0 +1,230 @@
+#include "menu.h"
+#include <string.h>
+#include "sensors.h"
+#include "sd.h"
+#include "uss_handler.h"
+#include "fixed_format.h"
+
+typedef struct {
+    const char* label;
+    int32_t min;
+    int32_t max;
+    int32_t step;
+    uint8_t decimals;           // of the displayed value
+    const char* unit;
+    const char* const* names;   // names of the values min..max, NULL for numbers
+    int32_t (*get)();
+    void (*set)(int32_t value);
+} MenuEntry;
+
+static int32_t getDpPeriod() {
+    return TIME_I2MS(getSensorPeriod("SDP3x"));
+}
+
+static void setDpPeriod(int32_t ms) {
+    setSensorPeriod("SDP3x", TIME_MS2I(ms));
+}
+
+static int32_t getRhPeriod() {
+    return TIME_I2MS(getSensorPeriod("SHT4x"));
+}
+
+static void setRhPeriod(int32_t ms) {
+    setSensorPeriod("SHT4x", TIME_MS2I(ms));
+}
+
+static const char* const filter_names[] = {"none", "average", "low pass", "median"};
+
+static int32_t getFilterType() {
+    return getDpFilterConfig().type;
+}
+
+static void setFilterType(int32_t type) {
+    DpFilterConfig config = getDpFilterConfig();
+    config.type = (DpFilterType)type;
+    setDpFilterConfig(&config);
+}
+
+static int32_t getFilterLength() {
+    return getDpFilterConfig().length;
+}
+
+static void setFilterLength(int32_t length) {
+    DpFilterConfig config = getDpFilterConfig();
+    config.length = length;
+    setDpFilterConfig(&config);
+}
+
+// in hundredths
+static int32_t getFilterAlpha() {
+    return getDpFilterConfig().alpha * 100.0f + 0.5f;
+}
+
+static void setFilterAlpha(int32_t alpha) {
+    DpFilterConfig config = getDpFilterConfig();
+    config.alpha = alpha * 0.01f;
+    setDpFilterConfig(&config);
+}
+
+static int32_t getDecimation() {
+    return getDpFilterConfig().decimation;
+}
+
+static void setDecimation(int32_t decimation) {
+    DpFilterConfig config = getDpFilterConfig();
+    config.decimation = decimation;
+    setDpFilterConfig(&config);
+}
+
+static const char* const log_mode_names[] = {"decimated", "raw"};
+
+static int32_t getLogMode() {
+    return getSensorLogMode();
+}
+
+static void setLogMode(int32_t mode) {
+    setSensorLogMode((SensorLogMode)mode);
+}
+
+// rates with a valid response delay, see uss_port.cpp
+static const uint32_t uss_speeds[] = {9600, 19200, 38400, 115200, 187500};
+static const char* const uss_speed_names[] = {"9600", "19200", "38400", "115200", "187500"};
+#define USS_SPEED_NB (sizeof(uss_speeds)/sizeof(uss_speeds[0]))
+
+static int32_t getUssSpeed() {
+    const uint32_t speed = getUSSBaudrate();
+    for(size_t i=0; i<USS_SPEED_NB; i++) {
+        if(uss_speeds[i] == speed) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+static void setUssSpeed(int32_t index) {
+    setUSSBaudrate(uss_speeds[index]);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static const MenuEntry entries[] = {
+    {.label = "dp period", .min = 5, .max = 100, .step = 5, .unit = " ms",
+     .get = getDpPeriod, .set = setDpPeriod},
+    {.label = "rh period", .min = 100, .max = 10000, .step = 100, .unit = " ms",
+     .get = getRhPeriod, .set = setRhPeriod},
+    {.label = "dp filter", .min = DP_FILTER_NONE, .max = DP_FILTER_MEDIAN, .step = 1,
+     .names = filter_names, .get = getFilterType, .set = setFilterType},
+    {.label = "filter length", .min = 1, .max = DP_FILTER_MAX_LEN, .step = 1,
+     .get = getFilterLength, .set = setFilterLength},
+    {.label = "filter alpha", .min = 1, .max = 100, .step = 1, .decimals = 2,
+     .get = getFilterAlpha, .set = setFilterAlpha},
+    {.label = "decimation", .min = 1, .max = 100, .step = 1,
+     .get = getDecimation, .set = setDecimation},
+    {.label = "log mode", .min = SENSOR_LOG_MODE_DECIMATED, .max = SENSOR_LOG_MODE_RAW, .step = 1,
+     .names = log_mode_names, .get = getLogMode, .set = setLogMode},
+    {.label = "USS bauds", .min = 0, .max = USS_SPEED_NB - 1, .step = 1,
+     .names = uss_speed_names, .get = getUssSpeed, .set = setUssSpeed},
+};
+#pragma GCC diagnostic pop
+#define MENU_ENTRY_NB (sizeof(entries)/sizeof(entries[0]))
+
+static MUTEX_DECL(menu_mtx);
+static EVENTSOURCE_DECL(menu_event);
+static bool active = false;
+static bool editing = false;
+static size_t selected = 0;
+static int32_t edit_value;
+
+static void changed() {
+    chEvtBroadcast(&menu_event);
+}
+
+void menuOpen() {
+    chMtxLock(&menu_mtx);
+    active = true;
+    editing = false;
+    chMtxUnlock(&menu_mtx);
+    changed();
+}
+
+void menuClose() {
+    chMtxLock(&menu_mtx);
+    // an edit in progress is discarded
+    active = false;
+    editing = false;
+    chMtxUnlock(&menu_mtx);
+    changed();
+}
+
+bool menuIsActive() {
+    return active;
+}
+
+void menuTurn(int32_t steps) {
+    chMtxLock(&menu_mtx);
+    if(!active || steps == 0) {
+        chMtxUnlock(&menu_mtx);
+        return;
+    }
+    if(editing) {
+        const MenuEntry* e = &entries[selected];
+        edit_value += steps * e->step;
+        if(edit_value < e->min) {
+            edit_value = e->min;
+        } else if(edit_value > e->max) {
+            edit_value = e->max;
+        }
+    } else {
+        // wraps around
+        int32_t s = ((int32_t)selected + steps) % (int32_t)MENU_ENTRY_NB;
+        selected = s < 0 ? s + MENU_ENTRY_NB : s;
+    }
+    chMtxUnlock(&menu_mtx);
+    changed();
+}
+
+void menuPress() {
+    chMtxLock(&menu_mtx);
+    if(!active) {
+        chMtxUnlock(&menu_mtx);
+        return;
+    }
+    const MenuEntry* e = &entries[selected];
+    if(editing) {
+        e->set(edit_value);
+        editing = false;
+    } else {
+        edit_value = e->get();
+        editing = true;
+    }
+    chMtxUnlock(&menu_mtx);
+    changed();
+}
+
+MenuView menuGetView() {
+    MenuView view;
+    chMtxLock(&menu_mtx);
+    const MenuEntry* e = &entries[selected];
+    const int32_t value = editing ? edit_value : e->get();
+    view.active = active;
+    view.editing = editing;
+    strncpy(view.label, e->label, MENU_TEXT_LEN);
+    view.label[MENU_TEXT_LEN] = '\0';
+    if(e->names) {
+        strncpy(view.value, e->names[value - e->min], MENU_TEXT_LEN);
+    } else {
+        char buffer[FMT_FIXED_MAX_LEN];
+        fmtFixed(buffer, value, 0, e->decimals);
+        strncpy(view.value, buffer, MENU_TEXT_LEN);
+        if(e->unit) {
+            strncat(view.value, e->unit, MENU_TEXT_LEN - strlen(view.value));
+        }
+    }
+    view.value[MENU_TEXT_LEN] = '\0';
+    chMtxUnlock(&menu_mtx);
+    return view;
+}
+
+event_source_t* menuEventSource() {
+    return &menu_event;
+}
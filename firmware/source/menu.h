@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "ch.h"
+
+// Settings menu, driven by the encoder.
+// A long press opens and closes the menu. Turning the encoder selects an
+// entry, a press starts editing it, turning changes the value and a second
+// press applies it. The settings take effect immediately, without reboot.
+
+#define MENU_TEXT_LEN 15
+
+/**
+ * What the display shows of the menu.
+ */
+typedef struct {
+    bool active;
+    bool editing;
+    char label[MENU_TEXT_LEN + 1];
+    char value[MENU_TEXT_LEN + 1];
+} MenuView;
+
+void menuOpen();
+void menuClose();
+bool menuIsActive();
+
+/**
+ * Encoder rotation, in detents: moves the selection, or changes the edited value.
+ */
+void menuTurn(int32_t steps);
+
+/**
+ * Short press: start editing the selected entry, or apply the edited value.
+ */
+void menuPress();
+
+MenuView menuGetView();
+
+/**
+ * Broadcast when the view changes.
+ */
+event_source_t* menuEventSource();
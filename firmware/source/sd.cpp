@@ -3,6 +3,8 @@
 #include "sdLog.h"
 #include "sdio.h"
 #include "sensors.h"
+#include "sensor_log.h"
+#include "uss_handler.h"
 
 bool sdlog_initialized = false;
 thread_t* sdlog_watcher_thd = NULL;
@@ -86,32 +88,83 @@ bool sdLogInitialized() {
 
 
 
+static_assert((int)SENSOR_LOG_BMP3_OK == (int)SENSOR_BMP3_VALID &&
+              (int)SENSOR_LOG_SDP3X_OK == (int)SENSOR_SDP3X_VALID &&
+              (int)SENSOR_LOG_SHT4X_OK == (int)SENSOR_SHT4X_VALID &&
+              (int)SENSOR_LOG_DP_FILTERED_OK == (int)SENSOR_DP_FILTERED_VALID,
+              "sensor status bits are logged as is");
+
+static SensorLogMode sensor_log_mode = SENSOR_LOG_MODE_DECIMATED;
+
+// written whole to the SD, one sector at a time
+static IN_DMA_SECTION(SensorLogBlock log_block);
+
+static bool writeLogBlock() {
+  if(sdLogWriteRaw(log_data_fd, (uint8_t*)&log_block, sizeof(log_block)) != SDLOG_OK) {
+    return false;
+  }
+  sensorLogBlockInit(&log_block, log_block.header.seq + 1);
+  return true;
+}
+
 static THD_WORKING_AREA(waSensorLog, 4096);
 void sensorLogThd(void*) {
   chRegSetThreadName("SdLogger");
 
-  while(!chThdShouldTerminateX()) {
+  sensorLogBlockInit(&log_block, 0);
+  setSampleStreamEnabled(true);
 
-    float tunnel_temp = getTunnelTemp();
-    float temp = getTemp();
-    float pressure = getAbsolutePressure();
-    float diff_p = getDiffPressure();
+  while(!chThdShouldTerminateX()) {
 
-    if(sdLogWriteLog(log_data_fd, "%f,%f,%f,%f\n", tunnel_temp, temp, diff_p, pressure) != SDLOG_OK) {
+    SensorSample sample;
+    if(fetchStreamSample(&sample, chTimeMS2I(100)) != MSG_OK) {
+      continue;
+    }
+    if(sensor_log_mode == SENSOR_LOG_MODE_DECIMATED && sample.updated == SENSOR_SDP3X_VALID) {
+      // raw differential pressure only
+      continue;
+    }
+    DriveState drive = getDriveState();
+    SensorLogRecord rec = {
+      .timestamp = sample.time,
+      .flags = (uint16_t)(sample.valid | (drive.valid ? SENSOR_LOG_DRIVE_OK : 0)),
+      .updated = sample.updated,
+      .tunnel_temp = sample.tunnel_temp,
+      .temp = sample.temp,
+      .diff_p = sample.diff_p,
+      .pressure = sample.pressure,
+      .diff_p_raw = sample.diff_p_raw,
+      .fan_freq = drive.actual,
+    };
+
+    if(sensorLogBlockAppend(&log_block, &rec) && !writeLogBlock()) {
+      setSampleStreamEnabled(false);
       sdLogCloseLog(log_data_fd);   // try to close log, but will probably fail
       sensor_log_status = false;
       return;
     }
-
-    chThdSleepMilliseconds(500);    
   }
 
+  setSampleStreamEnabled(false);
+
+  // flush the partially filled block
+  if(!sensorLogBlockEmpty(&log_block)) {
+    writeLogBlock();
+  }
   sdLogCloseLog(log_data_fd);
   sensor_log_status = false;
 }
 
 
 
+void setSensorLogMode(SensorLogMode mode) {
+  sensor_log_mode = mode;
+}
+
+SensorLogMode getSensorLogMode() {
+  return sensor_log_mode;
+}
+
 msg_t startSensorLog() {
   if(sensor_log_status) {
     // already started
@@ -127,7 +180,6 @@ msg_t startSensorLog() {
     return MSG_RESET;
   }
 
-  sdLogWriteLog(log_data_fd,"tunnel_temp,temp,diff_p,pressure\n");
   sensor_log_status = true;
 
   sensor_log_th_handle = chThdCreateStatic(waSensorLog, sizeof(waSensorLog), NORMALPRIO + 1, sensorLogThd, NULL);
@@ -7,6 +7,14 @@ void stopSdLog();
 bool sdLogInitialized();
 
 
+typedef enum {
+  SENSOR_LOG_MODE_DECIMATED,  // filtered differential pressure and slow channels only
+  SENSOR_LOG_MODE_RAW,        // every differential pressure sample as well
+} SensorLogMode;
+
+void setSensorLogMode(SensorLogMode mode);
+SensorLogMode getSensorLogMode();
+
 msg_t startSensorLog();
 void stopSensorLog();
 bool isLoggingSensors();
@@ -0,0 +1,18 @@
+#include "sensor_log.h"
+#include "string.h"
+
+void sensorLogBlockInit(SensorLogBlock* blk, uint32_t seq) {
+    memset(blk, 0, sizeof(*blk));
+    blk->header.magic = SENSOR_LOG_MAGIC;
+    blk->header.version = SENSOR_LOG_VERSION;
+    blk->header.count = 0;
+    blk->header.seq = seq;
+}
+
+bool sensorLogBlockAppend(SensorLogBlock* blk, const SensorLogRecord* rec) {
+    if(blk->header.count < SENSOR_LOG_RECORDS_PER_BLOCK) {
+        blk->records[blk->header.count] = *rec;
+        blk->header.count++;
+    }
+    return blk->header.count >= SENSOR_LOG_RECORDS_PER_BLOCK;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary sensor log format
+// The log file is a sequence of 512 bytes blocks (one SD sector each).
+// Block: header | record 0 | ... | record N-1
+// Only the last block of a file can be partially filled: `count` gives the
+// number of valid records, the remaining bytes are zeroes.
+// All fields are little endian. See tools/sensor_log_to_csv.py for the decoder.
+
+#define SENSOR_LOG_BLOCK_SIZE 512
+#define SENSOR_LOG_MAGIC 0x4C53     // "SL"
+#define SENSOR_LOG_VERSION 3
+
+typedef enum {
+    SENSOR_LOG_BMP3_OK = 1 << 0,    // temp and pressure valid
+    SENSOR_LOG_SDP3X_OK = 1 << 1,   // diff_p_raw valid
+    SENSOR_LOG_SHT4X_OK = 1 << 2,   // tunnel_temp valid
+    SENSOR_LOG_DP_FILTERED_OK = 1 << 3, // diff_p valid
+    SENSOR_LOG_DRIVE_OK = 1 << 4,   // fan_freq valid
+} SensorLogFlags;
+
+typedef struct {
+    uint16_t magic;         // SENSOR_LOG_MAGIC
+    uint8_t version;        // SENSOR_LOG_VERSION
+    uint8_t count;          // number of valid records in the block
+    uint32_t seq;           // block sequence number, starts at 0 for each file
+} __attribute__((packed)) SensorLogBlockHeader;
+
+typedef struct {
+    uint32_t timestamp;     // system time, in ticks (CH_CFG_ST_FREQUENCY)
+    uint16_t flags;         // SensorLogFlags: valid channels
+    uint16_t updated;       // SensorLogFlags: channels updated by this record
+    float tunnel_temp;      // °C
+    float temp;             // °C
+    float diff_p;           // filtered, Pa
+    float pressure;         // hPa
+    float diff_p_raw;       // Pa
+    float fan_freq;         // fan inverter actual frequency, Hz
+} __attribute__((packed)) SensorLogRecord;
+
+#define SENSOR_LOG_RECORDS_PER_BLOCK \
+    ((SENSOR_LOG_BLOCK_SIZE - sizeof(SensorLogBlockHeader)) / sizeof(SensorLogRecord))
+
+typedef struct {
+    SensorLogBlockHeader header;
+    SensorLogRecord records[SENSOR_LOG_RECORDS_PER_BLOCK];
+    uint8_t padding[SENSOR_LOG_BLOCK_SIZE - sizeof(SensorLogBlockHeader)
+                    - SENSOR_LOG_RECORDS_PER_BLOCK * sizeof(SensorLogRecord)];
+} __attribute__((packed)) SensorLogBlock;
+
+static_assert(sizeof(SensorLogRecord) == 32, "SensorLogRecord layout changed, bump SENSOR_LOG_VERSION");
+static_assert(sizeof(SensorLogBlock) == SENSOR_LOG_BLOCK_SIZE, "SensorLogBlock must fill exactly one sector");
+
+/**
+ * Reset the block to an empty block with the given sequence number.
+ */
+void sensorLogBlockInit(SensorLogBlock* blk, uint32_t seq);
+
+/**
+ * Append a record to the block.
+ * @return true if the block is full and must be written.
+ */
+bool sensorLogBlockAppend(SensorLogBlock* blk, const SensorLogRecord* rec);
+
+static inline bool sensorLogBlockEmpty(const SensorLogBlock* blk) {
+    return blk->header.count == 0;
+}
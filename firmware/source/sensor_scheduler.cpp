@@ -0,0 +1,61 @@
+#include "sensor_scheduler.h"
+
+// signed distance from `now` to `t`, valid across systime_t wrap-around
+static inline int32_t timeTo(systime_t t, systime_t now) {
+    return (int32_t)(t - now);
+}
+
+void sensorSchedInit(SensorScheduler* sched, SensorTask* tasks, size_t nb_tasks, systime_t now) {
+    sched->tasks = tasks;
+    sched->nb_tasks = nb_tasks;
+    for(size_t i=0; i<nb_tasks; i++) {
+        tasks[i].start = now;
+        tasks[i].deadline = now;
+        tasks[i].converting = false;
+    }
+}
+
+SensorTask* sensorSchedNext(SensorScheduler* sched, systime_t now) {
+    SensorTask* next = &sched->tasks[0];
+    for(size_t i=1; i<sched->nb_tasks; i++) {
+        if(timeTo(sched->tasks[i].deadline, now) < timeTo(next->deadline, now)) {
+            next = &sched->tasks[i];
+        }
+    }
+    return next;
+}
+
+sysinterval_t sensorSchedTimeToDeadline(const SensorTask* task, systime_t now) {
+    int32_t dt = timeTo(task->deadline, now);
+    return dt > 0 ? (sysinterval_t)dt : 0;
+}
+
+// schedule the next acquisition one period after the start of this one,
+// or one period from now if the acquisition overran its period.
+static void scheduleNextPeriod(SensorTask* task, systime_t now) {
+    task->converting = false;
+    task->deadline = task->start + task->period;
+    if(timeTo(task->deadline, now) <= 0) {
+        task->deadline = now + task->period;
+    }
+}
+
+SensorTaskEvent sensorSchedRun(SensorTask* task, systime_t now) {
+    if(task->trigger != NULL && !task->converting) {
+        task->start = now;
+        if(task->trigger() != MSG_OK) {
+            scheduleNextPeriod(task, now);
+            return SENSOR_TASK_FAILED;
+        }
+        task->converting = true;
+        task->deadline = now + task->conversion;
+        return SENSOR_TASK_TRIGGERED;
+    }
+
+    if(task->trigger == NULL) {
+        task->start = now;
+    }
+    msg_t status = task->fetch();
+    scheduleNextPeriod(task, now);
+    return status == MSG_OK ? SENSOR_TASK_FETCHED : SENSOR_TASK_FAILED;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "ch.h"
+
+// Earliest-deadline scheduler for sensors sharing one acquisition thread.
+// Each sensor has its own acquisition period and, for sensors that need a
+// conversion command, the latency between trigger and fetch. The thread
+// sleeps until the next deadline instead of blocking on a conversion.
+
+typedef msg_t (*SensorTaskFn)(void);
+
+typedef enum {
+    SENSOR_TASK_TRIGGERED,  // conversion started, fetch is scheduled
+    SENSOR_TASK_FETCHED,    // new data available
+    SENSOR_TASK_FAILED,     // trigger or fetch failed, retried next period
+} SensorTaskEvent;
+
+typedef struct {
+    const char* name;
+    sysinterval_t period;       // time between the start of two acquisitions
+    sysinterval_t conversion;   // delay between trigger and fetch
+    SensorTaskFn trigger;       // start a conversion, NULL for free running sensors
+    SensorTaskFn fetch;         // read the last conversion
+
+    // runtime
+    systime_t start;            // start of the current acquisition
+    systime_t deadline;         // next time the task must run
+    bool converting;            // trigger done, waiting for fetch
+} SensorTask;
+
+typedef struct {
+    SensorTask* tasks;
+    size_t nb_tasks;
+} SensorScheduler;
+
+/**
+ * All tasks are due at `now`.
+ */
+void sensorSchedInit(SensorScheduler* sched, SensorTask* tasks, size_t nb_tasks, systime_t now);
+
+/**
+ * Task with the earliest deadline. Overdue tasks come first.
+ */
+SensorTask* sensorSchedNext(SensorScheduler* sched, systime_t now);
+
+/**
+ * Time until the task is due, 0 if it is already overdue.
+ */
+sysinterval_t sensorSchedTimeToDeadline(const SensorTask* task, systime_t now);
+
+/**
+ * Run the trigger or the fetch step of the task, and compute its next deadline.
+ */
+SensorTaskEvent sensorSchedRun(SensorTask* task, systime_t now);
@@ -2,12 +2,32 @@
 #include "hal.h"
 #include "ch.h"
 #include "stdutil++.hpp"
+#include "seqlock.h"
+#include "sensor_scheduler.h"
+#include "airspeed.h"
+#include <string.h>
 extern "C" {
     #include "i2cPeriphBMP3XX.h"
     #include "i2cPeriphSDP3X.h"
     #include "i2cPeriphSHT4x.h"
+    #include "i2cPeriphBMP3Fifo.h"
 }
 
+// TRUE: drain the BMP3 hardware FIFO and publish every frame
+// FALSE: fetch only the last BMP3 sample
+#define BMP3_USE_FIFO TRUE
+
+// FIFO mode: 8x pressure and 1x temperature oversampling fit in a 50Hz ODR period
+#define BMP3_FIFO_ODR BMP3_ODR_50_HZ
+#define BMP3_FIFO_PRESS_OS BMP3_OVERSAMPLING_8X
+#define BMP3_FIFO_TEMP_OS BMP3_NO_OVERSAMPLING
+
+// 200Hz SDP3x samples, averaged and decimated to 10Hz
+#define DP_FILTER_DEFAULT_CONFIG {.type = DP_FILTER_MOVING_AVERAGE, .length = 20, .alpha = 0.1f, .decimation = 20}
+
+// samples queued for the logger
+#define SAMPLE_STREAM_LEN 64
+
 // Digital noise filter: 0 disabled, [0x1 - 0xF] enable up to n t_I2CCLK
 #define STM32_CR1_DNF(n)          ((n & 0x0f) << 8)
 
@@ -25,6 +45,7 @@ I2CConfig i2c2_conf = {
 
 
 
+#if !BMP3_USE_FIFO
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
 Bmp3xxConfig bmp3_conf = {
@@ -44,26 +65,223 @@ Bmp3xxConfig bmp3_conf = {
                     BMP3_SEL_TEMP_OS | BMP3_SEL_ODR /* | BMP3_SEL_DRDY_EN*/
 };
 #pragma GCC diagnostic pop
+#endif
 
 
 Sdp3xDriver  IN_DMA_SECTION(sdp);
 Sht4xDriver  IN_DMA_SECTION(sht);
+#if BMP3_USE_FIFO
+Bmp3FifoDriver IN_DMA_SECTION(bmp3_fifo);
+#else
 Bmp3xxDriver IN_DMA_SECTION(bmp3);
+#endif
+
+static SeqLock<SensorSample> sensor_sample;
+
+// working copy, shared by the bus threads
+static SensorSample sample = {
+    .time = 0, .temp = 0, .pressure = 0, .diff_p = 0, .diff_p_raw = 0, .tunnel_temp = 0, .rh = 0,
+    .air_density = AIR_DENSITY_STD, .airspeed_factor = 2.0f / AIR_DENSITY_STD, .valid = 0, .updated = 0
+};
+
+/**
+ * Air density from the last valid channels.
+ * Fall back on the board temperature, then on standard conditions.
+ */
+static float sampleAirDensity(const SensorSample& s) {
+    float pressure = (s.valid & SENSOR_BMP3_VALID) ? s.pressure * 100.0f : 101325.0f;
+    float temp = 15.0f;
+    float rh = 0;
+    if(s.valid & SENSOR_SHT4X_VALID) {
+        temp = s.tunnel_temp;
+        rh = s.rh;
+    } else if(s.valid & SENSOR_BMP3_VALID) {
+        temp = s.temp;
+    }
+    return airDensity(pressure, temp, rh);
+}
+static MUTEX_DECL(sample_mtx);
+
+// only used by the I2C1 thread, the configuration is changed through dp_filter_config
+static DpFilter dp_filter;
+static DpFilterConfig dp_filter_config = DP_FILTER_DEFAULT_CONFIG;
+static bool dp_filter_config_changed = true;
+
+// dp calibration, the offset and gain are changed through dp_calib_*
+static float dp_calib_offset = 0.0f;
+static float dp_calib_gain = 1.0f;
+static bool dp_calib_changed = true;
+// only used by the I2C1 thread: dp = raw * dp_gain + dp_bias, a single multiply-add
+static float dp_gain = 1.0f;
+static float dp_bias = 0.0f;
+
+// tare: sum of the uncalibrated samples, under sample_mtx
+static uint16_t tare_remaining = 0;
+static uint16_t tare_nb = 0;
+static float tare_sum = 0.0f;
+static BSEMAPHORE_DECL(tare_sem, true);
+
+// every published sample, while the stream is enabled
+static SensorSample stream_buffer[SAMPLE_STREAM_LEN];
+static msg_t stream_msgs[SAMPLE_STREAM_LEN];
+static objects_fifo_t sample_stream;
+static bool stream_enabled = false;
+static uint32_t stream_drops = 0;
+
+/**
+ * Update the channels of one sensor in the working copy and publish it.
+ * `sensor` is a mask of SensorValid bits.
+ * `update` is only called if the acquisition succeeded.
+ */
+template <typename F>
+static void publishSample(uint16_t sensor, bool valid, systime_t time, F update) {
+    chMtxLock(&sample_mtx);
+    sample.updated = sensor;
+    if(valid) {
+        update(sample);
+        sample.valid |= sensor;
+    } else {
+        sample.valid &= ~sensor;
+    }
+    if(sensor & (SENSOR_BMP3_VALID | SENSOR_SHT4X_VALID)) {
+        // slow channels: air density is only updated here
+        sample.air_density = sampleAirDensity(sample);
+        sample.airspeed_factor = airspeedFactor(sample.air_density);
+    }
+    sample.time = time;
+    sensor_sample.write(sample);
+
+    if(stream_enabled) {
+        SensorSample* slot = (SensorSample*)chFifoTakeObjectTimeout(&sample_stream, TIME_IMMEDIATE);
+        if(slot != NULL) {
+            *slot = sample;
+            chFifoSendObject(&sample_stream, slot);
+        } else {
+            stream_drops++;
+        }
+    }
+    chMtxUnlock(&sample_mtx);
+}
+
+template <typename F>
+static void publishSample(uint16_t sensor, bool valid, F update) {
+    publishSample(sensor, valid, chVTGetSystemTime(), update);
+}
+
+#if BMP3_USE_FIFO
+static msg_t bmp3Fetch() {
+    systime_t now = chVTGetSystemTime();
+    msg_t status = bmp3FifoDrain(&bmp3_fifo);
+    if(status != MSG_OK) {
+        DebugTrace ("bmp fifo FAIL");
+        publishSample(SENSOR_BMP3_VALID, false, [](SensorSample&) {});
+        return status;
+    }
+
+    // the last frame was acquired just before the drain, the others one ODR period apart
+    const uint32_t period_us = bmp3FifoFramePeriodUs(&bmp3_fifo);
+    const uint8_t nb_frames = bmp3_fifo.nb_frames;
+    for(uint8_t i=0; i<nb_frames; i++) {
+        systime_t t = now - TIME_US2I(period_us * (nb_frames - 1 - i));
+        publishSample(SENSOR_BMP3_VALID, true, t, [i](SensorSample& s) {
+            s.temp = bmp3FifoGetTemp(&bmp3_fifo, i);
+            s.pressure = bmp3FifoGetPressure(&bmp3_fifo, i)/100.0f;
+        });
+    }
+    return MSG_OK;
+}
+#else
+static msg_t bmp3Fetch() {
+    msg_t status = bmp3xxFetch(&bmp3, BMP3_PRESS | BMP3_TEMP);
+    if(status != MSG_OK) {
+        DebugTrace ("bmp fetch FAIL");
+    }
+    publishSample(SENSOR_BMP3_VALID, status == MSG_OK, [](SensorSample& s) {
+        s.temp = bmp3xxGetTemp(&bmp3);
+        s.pressure = bmp3xxGetPressure(&bmp3)/100.0f;
+    });
+    return status;
+}
+#endif
+
+static msg_t sdp3xFetchPressure() {
+    msg_t status = sdp3xFetch(&sdp, SDP3X_pressure_temp);
+    if(status != MSG_OK) {
+        DebugTrace ("SDP31 fetch FAIL");
+        publishSample(SENSOR_SDP3X_VALID | SENSOR_DP_FILTERED_VALID, false, [](SensorSample&) {});
+        return status;
+    }
+
+    const float uncalibrated = sdp3xGetPressure(&sdp);
+
+    chMtxLock(&sample_mtx);
+    if(dp_filter_config_changed) {
+        dpFilterInit(&dp_filter, &dp_filter_config);
+        dp_filter_config_changed = false;
+    }
+    if(dp_calib_changed) {
+        dp_gain = dp_calib_gain;
+        dp_bias = -dp_calib_offset * dp_calib_gain;
+        dp_calib_changed = false;
+    }
+    if(tare_remaining > 0) {
+        tare_sum += uncalibrated;
+        tare_remaining--;
+        if(tare_remaining == 0) {
+            chBSemSignal(&tare_sem);
+        }
+    }
+    chMtxUnlock(&sample_mtx);
 
-static IN_DMA_SECTION(THD_WORKING_AREA(waSensors, 2048));
+    const float raw = uncalibrated * dp_gain + dp_bias;
+    float filtered;
+    if(dpFilterPush(&dp_filter, raw, &filtered)) {
+        publishSample(SENSOR_SDP3X_VALID | SENSOR_DP_FILTERED_VALID, true, [raw, filtered](SensorSample& s) {
+            s.diff_p_raw = raw;
+            s.diff_p = filtered;
+        });
+    } else {
+        publishSample(SENSOR_SDP3X_VALID, true, [raw](SensorSample& s) {
+            s.diff_p_raw = raw;
+        });
+    }
+    return status;
+}
 
-static void sensorsThd(void*) {
-    chRegSetThreadName("sensorsThd");
+static msg_t sht4xTrigger() {
+    msg_t status = sht4xSend(&sht, SHT4x_TEMP_RH_HI);
+    if(status != MSG_OK) {
+        DebugTrace ("SHT45 send command failed");
+        publishSample(SENSOR_SHT4X_VALID, false, [](SensorSample&) {});
+    }
+    return status;
+}
 
-    i2cStart(&I2CD1, &i2c1_conf);
-    i2cStart(&I2CD2, &i2c2_conf);
+static msg_t sht4xFetchTempRH() {
+    msg_t status = sht4xFetch(&sht);
+    if(status != MSG_OK) {
+        DebugTrace ("SHT45 fetch command failed");
+    }
+    publishSample(SENSOR_SHT4X_VALID, status == MSG_OK, [](SensorSample& s) {
+        s.tunnel_temp = sht4xGetTemp(&sht);
+        s.rh = sht4xGetRH(&sht);
+    });
+    return status;
+}
 
+static void i2c1Init() {
+#if BMP3_USE_FIFO
+    if(bmp3FifoStart(&bmp3_fifo, &I2CD1, BMP3_ADDR_I2C_PRIM,
+                     BMP3_FIFO_ODR, BMP3_FIFO_PRESS_OS, BMP3_FIFO_TEMP_OS) != MSG_OK) {
+        DebugTrace ("bmp init FAIL");
+    }
+#else
     if(bmp3xxStart(&bmp3, &bmp3_conf) == MSG_OK) {
         //DebugTrace ("bmp init OK");
     } else {
         DebugTrace ("bmp init FAIL");
     }
-
+#endif
 
     sdp3xStart(&sdp, &I2CD1, SDP3X_ADDRESS1);
     sdp3xStop(&sdp);
@@ -72,63 +290,261 @@ static void sensorsThd(void*) {
     sdp3xFetch(&sdp, SDP3X_pressure_temp_scale_oneshot);
     // request continuous pressure
     sdp3xRequest(&sdp, SDP3X_pressure_temp);
+}
 
+static void i2c2Init() {
     sht4xStart(&sht, &I2CD2, SHT4X_ADDRESS1);
 
     sht4xSend(&sht, SHT4x_READ_IDENT);
     sht4xFetch(&sht);
-    
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static SensorTask i2c1_tasks[] = {
+    // SDP3x in continuous mode, averaging until read
+    {.name = "SDP3x", .period = TIME_MS2I(5), .conversion = 0,
+     .trigger = NULL, .fetch = sdp3xFetchPressure},
+#if BMP3_USE_FIFO
+    // BMP3 FIFO holds up to 73 frames, drain it every 12 frames at 50Hz
+    {.name = "BMP3", .period = TIME_MS2I(240), .conversion = 0,
+     .trigger = NULL, .fetch = bmp3Fetch},
+#else
+    // BMP3 in normal mode, one new sample per ODR period (12.5Hz)
+    {.name = "BMP3", .period = TIME_MS2I(80), .conversion = 0,
+     .trigger = NULL, .fetch = bmp3Fetch},
+#endif
+};
+
+static SensorTask i2c2_tasks[] = {
+    // SHT4x high precision measurement takes up to 8.3ms
+    {.name = "SHT4x", .period = TIME_MS2I(1000), .conversion = TIME_MS2I(10),
+     .trigger = sht4xTrigger, .fetch = sht4xFetchTempRH},
+};
+#pragma GCC diagnostic pop
+
+#define SENSOR_BUS_MAX_TASKS 4
+
+/**
+ * Sensors sharing an I2C bus, acquired by their own thread so that
+ * transfers on different buses run concurrently.
+ */
+typedef struct {
+    const char* name;
+    I2CDriver* i2cp;
+    const I2CConfig* i2c_conf;
+    void (*init)(void);
+    SensorTask* tasks;
+    size_t nb_tasks;
+    SensorScheduler sched;
+    SensorTaskStats stats[SENSOR_BUS_MAX_TASKS];
+    systime_t stats_start;
+} SensorBus;
+
+static SensorBus sensor_buses[] = {
+    {.name = "sensors I2C1", .i2cp = &I2CD1, .i2c_conf = &i2c1_conf, .init = i2c1Init,
+     .tasks = i2c1_tasks, .nb_tasks = sizeof(i2c1_tasks)/sizeof(i2c1_tasks[0]),
+     .sched = {}, .stats = {}, .stats_start = 0},
+    {.name = "sensors I2C2", .i2cp = &I2CD2, .i2c_conf = &i2c2_conf, .init = i2c2Init,
+     .tasks = i2c2_tasks, .nb_tasks = sizeof(i2c2_tasks)/sizeof(i2c2_tasks[0]),
+     .sched = {}, .stats = {}, .stats_start = 0},
+};
+#define SENSOR_BUS_NB (sizeof(sensor_buses)/sizeof(sensor_buses[0]))
+
+static IN_DMA_SECTION(THD_WORKING_AREA(waSensorsI2C1, 2048));
+static IN_DMA_SECTION(THD_WORKING_AREA(waSensorsI2C2, 1024));
+
+static void resetTaskStats(SensorBus* bus) {
+    for(size_t i=0; i<bus->nb_tasks; i++) {
+        bus->stats[i] = (SensorTaskStats){
+            .runs = 0, .failures = 0, .min = UINT32_MAX, .max = 0, .total = 0
+        };
+    }
+    bus->stats_start = chVTGetSystemTime();
+}
+
+static void sensorBusThd(void* arg) {
+    SensorBus* bus = (SensorBus*)arg;
+    chRegSetThreadName(bus->name);
+
+    chDbgAssert(bus->nb_tasks <= SENSOR_BUS_MAX_TASKS, "too many tasks on sensor bus");
+    i2cStart(bus->i2cp, bus->i2c_conf);
+    bus->init();
+
+    resetTaskStats(bus);
+    sensorSchedInit(&bus->sched, bus->tasks, bus->nb_tasks, chVTGetSystemTime());
 
     while(true) {
-        if (bmp3xxFetch(&bmp3, BMP3_PRESS | BMP3_TEMP) != MSG_OK) {
-            DebugTrace ("bmp fetch FAIL");
+        SensorTask* task = sensorSchedNext(&bus->sched, chVTGetSystemTime());
+        sysinterval_t delay = sensorSchedTimeToDeadline(task, chVTGetSystemTime());
+        if(delay > 0) {
+            chThdSleep(delay);
         }
 
+        rtcnt_t t0 = chSysGetRealtimeCounterX();
+        SensorTaskEvent ev = sensorSchedRun(task, chVTGetSystemTime());
+        rtcnt_t dt = chSysGetRealtimeCounterX() - t0;
 
-        if(sdp3xFetch(&sdp, SDP3X_pressure_temp) != MSG_OK) {
-            DebugTrace ("SDP31 fetch FAIL");
+        SensorTaskStats* stats = &bus->stats[task - bus->tasks];
+        stats->runs++;
+        if(ev == SENSOR_TASK_FAILED) {
+            stats->failures++;
         }
+        stats->total += dt;
+        if(dt < stats->min) { stats->min = dt; }
+        if(dt > stats->max) { stats->max = dt; }
+    }
 
+}
 
-        if(sht4xSend(&sht, SHT4x_TEMP_RH_HI) == MSG_OK) {
-            chThdSleepMilliseconds(10);
-            if(sht4xFetch(&sht) != MSG_OK) {
-                DebugTrace ("SHT45 fetch command failed");
-            }
-        } else {
-            DebugTrace ("SHT45 send command failed");
+
+void printSensorStats(BaseSequentialStream *lchp) {
+    for(size_t b=0; b<SENSOR_BUS_NB; b++) {
+        SensorBus* bus = &sensor_buses[b];
+        // elapsed time, in realtime counter cycles
+        uint64_t elapsed = (uint64_t)chVTTimeElapsedSinceX(bus->stats_start) * (STM32_SYSCLK / CH_CFG_ST_FREQUENCY);
+        uint64_t busy = 0;
+        chprintf(lchp, "%s:\r\n", bus->name);
+        chprintf(lchp, "  task      runs  fails  min(us)  avg(us)  max(us)\r\n");
+        for(size_t i=0; i<bus->nb_tasks; i++) {
+            SensorTaskStats st = bus->stats[i];
+            busy += st.total;
+            rtcnt_t avg = st.runs ? st.total / st.runs : 0;
+            chprintf(lchp, "  %-8s %6lu %6lu %8lu %8lu %8lu\r\n", bus->tasks[i].name,
+                     st.runs, st.failures,
+                     st.runs ? (uint32_t)RTC2US(STM32_SYSCLK, st.min) : 0,
+                     st.runs ? (uint32_t)RTC2US(STM32_SYSCLK, avg) : 0,
+                     st.runs ? (uint32_t)RTC2US(STM32_SYSCLK, st.max) : 0);
         }
-        
+        // serialized on a single thread, buses occupations would add up
+        chprintf(lchp, "  bus busy %lu%%\r\n", elapsed ? (uint32_t)(busy * 100 / elapsed) : 0);
+    }
+    chprintf(lchp, "log stream drops: %lu\r\n", stream_drops);
+}
+
+void setSampleStreamEnabled(bool enabled) {
+    chMtxLock(&sample_mtx);
+    if(enabled && !stream_enabled) {
+        chFifoObjectInit(&sample_stream, sizeof(SensorSample), SAMPLE_STREAM_LEN,
+                         stream_buffer, stream_msgs);
+        stream_drops = 0;
+    }
+    stream_enabled = enabled;
+    chMtxUnlock(&sample_mtx);
+}
 
-        chThdSleepMilliseconds(500);
+msg_t fetchStreamSample(SensorSample* s, sysinterval_t timeout) {
+    SensorSample* slot;
+    msg_t ret = chFifoReceiveObjectTimeout(&sample_stream, (void**)&slot, timeout);
+    if(ret == MSG_OK) {
+        *s = *slot;
+        chFifoReturnObject(&sample_stream, slot);
     }
+    return ret;
+}
 
+void setDpFilterConfig(const DpFilterConfig* config) {
+    chMtxLock(&sample_mtx);
+    dp_filter_config = *config;
+    dp_filter_config_changed = true;
+    chMtxUnlock(&sample_mtx);
 }
 
+DpFilterConfig getDpFilterConfig() {
+    chMtxLock(&sample_mtx);
+    DpFilterConfig config = dp_filter_config;
+    chMtxUnlock(&sample_mtx);
+    return config;
+}
 
-float getTemp() {
-    return bmp3xxGetTemp(&bmp3);
+void setDpCalibration(float offset, float gain) {
+    chMtxLock(&sample_mtx);
+    dp_calib_offset = offset;
+    dp_calib_gain = gain;
+    dp_calib_changed = true;
+    // do not mix samples of both calibrations
+    dp_filter_config_changed = true;
+    chMtxUnlock(&sample_mtx);
 }
 
-float getAbsolutePressure() {
-    return bmp3xxGetPressure(&bmp3)/100.0f;
+void getDpCalibration(float* offset, float* gain) {
+    chMtxLock(&sample_mtx);
+    *offset = dp_calib_offset;
+    *gain = dp_calib_gain;
+    chMtxUnlock(&sample_mtx);
 }
 
-float getDiffPressure() {
-    return sdp3xGetPressure(&sdp);
+msg_t measureDpOffset(uint16_t nb_samples, sysinterval_t timeout, float* offset) {
+    if(nb_samples == 0) {
+        nb_samples = 1;
+    }
+    chMtxLock(&sample_mtx);
+    chBSemReset(&tare_sem, true);
+    tare_sum = 0.0f;
+    tare_nb = nb_samples;
+    tare_remaining = nb_samples;
+    chMtxUnlock(&sample_mtx);
+
+    msg_t ret = chBSemWaitTimeout(&tare_sem, timeout);
+
+    chMtxLock(&sample_mtx);
+    if(ret == MSG_OK) {
+        *offset = tare_sum / tare_nb;
+    } else {
+        tare_remaining = 0;
+    }
+    chMtxUnlock(&sample_mtx);
+    return ret;
 }
 
-float getTunnelTemp()
-{
-    return sht4xGetTemp(&sht);
+static SensorTask* findSensorTask(const char* name) {
+    for(size_t b=0; b<SENSOR_BUS_NB; b++) {
+        SensorBus* bus = &sensor_buses[b];
+        for(size_t i=0; i<bus->nb_tasks; i++) {
+            if(strcmp(bus->tasks[i].name, name) == 0) {
+                return &bus->tasks[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+bool setSensorPeriod(const char* name, sysinterval_t period) {
+    SensorTask* task = findSensorTask(name);
+    if(task == NULL) {
+        return false;
+    }
+    // single word store, read by the bus thread when it schedules the next acquisition
+    task->period = period;
+    return true;
+}
+
+sysinterval_t getSensorPeriod(const char* name) {
+    SensorTask* task = findSensorTask(name);
+    return task ? task->period : 0;
+}
+
+uint32_t getStreamDrops() {
+    return stream_drops;
+}
+
+void resetSensorStats() {
+    for(size_t b=0; b<SENSOR_BUS_NB; b++) {
+        resetTaskStats(&sensor_buses[b]);
+    }
+}
+
+
+SensorSample getSensorSample() {
+    return sensor_sample.read();
 }
 
-float getAirspeed()
+float getAirspeed(const SensorSample& sample)
 {
-    // TODO calculer airspeed
-    return getDiffPressure() + 12 + getTunnelTemp()/10.0;
+    return airspeedFromDp(sample.diff_p, sample.airspeed_factor);
 }
 
 void startSensors() {
-    chThdCreateStatic(waSensors, sizeof(waSensors), NORMALPRIO + 1, sensorsThd, NULL);
+    chThdCreateStatic(waSensorsI2C1, sizeof(waSensorsI2C1), NORMALPRIO + 1, sensorBusThd, &sensor_buses[0]);
+    chThdCreateStatic(waSensorsI2C2, sizeof(waSensorsI2C2), NORMALPRIO + 1, sensorBusThd, &sensor_buses[1]);
 }
@@ -1,13 +1,98 @@
 #pragma once
+#include <stdint.h>
+#include "ch.h"
+#include "hal.h"
+#include "dp_filter.h"
+
+// validity bits of the last acquisition of each sensor
+typedef enum {
+    SENSOR_BMP3_VALID = 1 << 0,
+    SENSOR_SDP3X_VALID = 1 << 1,
+    SENSOR_SHT4X_VALID = 1 << 2,
+    SENSOR_DP_FILTERED_VALID = 1 << 3,
+} SensorValid;
+
+/**
+ * Coherent snapshot of all sensor channels, published by the sensors thread.
+ */
+typedef struct {
+    systime_t time;         // system time of the acquisition
+    float temp;             // board temperature (BMP3), °C
+    float pressure;         // absolute pressure (BMP3), hPa
+    float diff_p;           // filtered and decimated differential pressure (SDP3x), Pa
+    float diff_p_raw;       // last differential pressure sample (SDP3x), Pa
+    float tunnel_temp;      // tunnel temperature (SHT4x), °C
+    float rh;               // tunnel relative humidity (SHT4x), %
+    float air_density;      // moist air density, from the channels above, kg/m³
+    float airspeed_factor;  // airspeedFactor(air_density), m³/kg
+    uint16_t valid;         // SensorValid bits
+    uint16_t updated;       // SensorValid bits of the channels updated by this sample
+} SensorSample;
+
+/**
+ * Acquisition timing of one sensor task, in realtime counter cycles.
+ */
+typedef struct {
+    uint32_t runs;
+    uint32_t failures;
+    rtcnt_t min;
+    rtcnt_t max;
+    uint64_t total;
+} SensorTaskStats;
 
 void startSensors(void);
 
-float getTemp();
+/**
+ * Print the per-bus acquisition latency and bus occupation.
+ */
+void printSensorStats(BaseSequentialStream *lchp);
+void resetSensorStats();
+
+/**
+ * Get the last published sample. Lock-free, can be called from any thread.
+ */
+SensorSample getSensorSample();
+
+/**
+ * Stream of every published sample, for the logger.
+ * Samples published while the stream is full are dropped.
+ * Enabling the stream discards the samples it still holds.
+ */
+void setSampleStreamEnabled(bool enabled);
+msg_t fetchStreamSample(SensorSample* sample, sysinterval_t timeout);
+uint32_t getStreamDrops();
+
+/**
+ * Differential pressure filter, the new configuration is applied on the next sample.
+ */
+void setDpFilterConfig(const DpFilterConfig* config);
+DpFilterConfig getDpFilterConfig();
 
-float getAbsolutePressure();
+/**
+ * Calibration of the raw SDP3x samples: dp = gain * (raw - offset).
+ * Applied from the next sample, the filter is restarted.
+ */
+void setDpCalibration(float offset, float gain);
+void getDpCalibration(float* offset, float* gain);
 
-float getDiffPressure();
+/**
+ * Average of the next `nb_samples` uncalibrated SDP3x samples, in Pa.
+ * @return MSG_TIMEOUT if the samples were not acquired within `timeout`
+ */
+msg_t measureDpOffset(uint16_t nb_samples, sysinterval_t timeout, float* offset);
 
-float getTunnelTemp();
+/**
+ * Acquisition period of a sensor task, by name ("SDP3x", "SHT4x").
+ * The new period is used from the next acquisition.
+ * @return false if there is no such task
+ */
+bool setSensorPeriod(const char* name, sysinterval_t period);
+/**
+ * @return the period of the task, 0 if there is no such task
+ */
+sysinterval_t getSensorPeriod(const char* name);
 
-float getAirspeed();
+/**
+ * Airspeed from the differential pressure and the air density, in m/s.
+ */
+float getAirspeed(const SensorSample& sample);
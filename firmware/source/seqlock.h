@@ -0,0 +1,57 @@
+#pragma once
+#include "ch.h"
+#include "hal.h"
+
+/**
+ * Sequence lock publishing a snapshot of T from one writer thread to any
+ * number of reader threads.
+ * Readers never take a lock: they copy the value and retry if it was
+ * updated meanwhile. The writer copies the value in a (short) critical
+ * section, so a reader can never preempt a write in progress and spin forever.
+ * T must be trivially copyable and small.
+ */
+template <typename T>
+class SeqLock {
+public:
+    void write(const T& value) {
+        chSysLock();
+        store(value);
+        chSysUnlock();
+    }
+
+    // same as write, from an interrupt handler
+    void writeFromISR(const T& value) {
+        chSysLockFromISR();
+        store(value);
+        chSysUnlockFromISR();
+    }
+
+    T read() const {
+        T value;
+        uint32_t start;
+        do {
+            start = seq;
+            __DMB();
+            value = data;
+            __DMB();
+        } while((start & 1) || start != seq);
+        return value;
+    }
+
+    // number of writes since startup
+    uint32_t version() const {
+        return seq / 2;
+    }
+
+private:
+    void store(const T& value) {
+        seq = seq + 1;      // odd: write in progress
+        __DMB();
+        data = value;
+        __DMB();
+        seq = seq + 1;
+    }
+
+    volatile uint32_t seq = 0;
+    T data = {};
+};
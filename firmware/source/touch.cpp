@@ -0,0 +1,91 @@
+#include "touch.h"
+#include "display_queue.h"
+
+#define TOUCH_EVENT EVENT_MASK(0)
+
+static const TouchButton* buttons;
+static size_t nb_buttons;
+static uint8_t page = 0;
+
+static const TouchButton* hitTest(DisplayTouchPoint p) {
+    for(size_t i=0; i<nb_buttons; i++) {
+        const TouchButton* b = &buttons[i];
+        if((b->pages & (1 << page)) &&
+           p.x >= b->x1 && p.x <= b->x2 && p.y >= b->y1 && p.y <= b->y2) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+// the handlers run here, the tare handler writes to the SD card
+static THD_WORKING_AREA(waTouch, 2048);
+static void touchThd(void*) {
+    chRegSetThreadName("touch");
+
+    event_listener_t touch_listener;
+    chEvtRegisterMaskWithFlags(displayTouchEventSource(), &touch_listener, TOUCH_EVENT,
+                               DISPLAY_TOUCH_PRESSED | DISPLAY_TOUCH_RELEASED | DISPLAY_TOUCH_MOVING);
+
+    bool pressed = false;
+    bool releasing = false;     // released, waiting for the end of the debounce time
+    const TouchButton* target = NULL;
+    systime_t press_time = 0;
+    systime_t release_time = 0;
+
+    while(true) {
+        sysinterval_t timeout = TIME_INFINITE;
+        if(releasing) {
+            const sysinterval_t elapsed = chVTTimeElapsedSinceX(release_time);
+            timeout = elapsed >= TOUCH_DEBOUNCE_TIME ? TIME_IMMEDIATE : TOUCH_DEBOUNCE_TIME - elapsed;
+        }
+        eventflags_t flags = 0;
+        if(chEvtWaitAnyTimeout(TOUCH_EVENT, timeout) & TOUCH_EVENT) {
+            flags = chEvtGetAndClearFlags(&touch_listener);
+        }
+
+        if(flags & DISPLAY_TOUCH_PRESSED) {
+            if(releasing) {
+                // bounce: same gesture
+                releasing = false;
+            } else if(!pressed) {
+                press_time = chVTGetSystemTimeX();
+                target = hitTest(displayGetTouchPoint());
+            }
+            pressed = true;
+        }
+        if((flags & DISPLAY_TOUCH_MOVING) && pressed && target != NULL) {
+            // sliding off the button cancels the tap
+            if(hitTest(displayGetTouchPoint()) != target) {
+                target = NULL;
+            }
+        }
+        if((flags & DISPLAY_TOUCH_RELEASED) && pressed) {
+            pressed = false;
+            releasing = true;
+            release_time = chVTGetSystemTimeX();
+        }
+
+        if(releasing && chVTTimeElapsedSinceX(release_time) >= TOUCH_DEBOUNCE_TIME) {
+            releasing = false;
+            if(target != NULL && chTimeDiffX(press_time, release_time) >= TOUCH_MIN_PRESS_TIME) {
+                target->handler();
+            }
+            target = NULL;
+        }
+    }
+}
+
+void touchStart(tprio_t prio, const TouchButton* b, size_t nb) {
+    buttons = b;
+    nb_buttons = nb;
+    chThdCreateStatic(waTouch, sizeof(waTouch), prio, touchThd, NULL);
+}
+
+void touchSetPage(uint8_t p) {
+    page = p;
+}
+
+uint8_t touchGetPage() {
+    return page;
+}
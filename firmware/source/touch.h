@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ch.h"
+
+// Touch screen buttons
+// The touch thread turns the status changes polled by the display writer
+// into taps: a press and its release on the same button. A release followed
+// by a new press within TOUCH_DEBOUNCE_TIME is a bounce, and the gesture goes
+// on. The button handlers are called by the touch thread, so they never delay
+// the display or the encoder.
+
+#define TOUCH_DEBOUNCE_TIME TIME_MS2I(60)
+#define TOUCH_MIN_PRESS_TIME TIME_MS2I(20)
+#define TOUCH_ALL_PAGES 0xFF
+
+typedef void (*TouchHandler)(void);
+
+typedef struct {
+    uint16_t x1;                // hit area, inclusive
+    uint16_t y1;
+    uint16_t x2;
+    uint16_t y2;
+    uint8_t pages;              // mask of the pages where the button is active
+    TouchHandler handler;
+} TouchButton;
+
+/**
+ * Start the touch thread with a static table of buttons.
+ */
+void touchStart(tprio_t prio, const TouchButton* buttons, size_t nb_buttons);
+
+/**
+ * Page shown by the display, selects the active buttons.
+ */
+void touchSetPage(uint8_t page);
+uint8_t touchGetPage();
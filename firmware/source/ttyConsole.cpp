@@ -10,6 +10,11 @@
 #include "usb_serial.h"
 //#include "rtcAccess.h"
 #include "printf.h"
+#include "sensors.h"
+#include "bench.h"
+#include "uss_handler.h"
+#include "display_queue.h"
+#include "calib.h"
 
 
 /*===========================================================================*/
@@ -21,6 +26,11 @@ static void cmd_mem(BaseSequentialStream *lchp, int argc,const char * const argv
 static void cmd_threads(BaseSequentialStream *lchp, int argc,const char * const argv[]);
 //static void cmd_rtc(BaseSequentialStream *lchp, int argc,const char * const argv[]);
 static void cmd_uid(BaseSequentialStream *lchp, int argc,const char * const argv[]);
+static void cmd_sensors(BaseSequentialStream *lchp, int argc,const char * const argv[]);
+static void cmd_bench(BaseSequentialStream *lchp, int argc,const char * const argv[]);
+static void cmd_uss(BaseSequentialStream *lchp, int argc,const char * const argv[]);
+static void cmd_display(BaseSequentialStream *lchp, int argc,const char * const argv[]);
+static void cmd_tare(BaseSequentialStream *lchp, int argc,const char * const argv[]);
 static void cmd_help(BaseSequentialStream *lchp, int argc,const char * const argv[]);
 
 static const ShellCommand commands[] = {
@@ -29,6 +39,11 @@ static const ShellCommand commands[] = {
   {"threads", cmd_threads},
   //{"rtc", cmd_rtc},
   {"uid", cmd_uid},
+  {"sensors", cmd_sensors},
+  {"bench", cmd_bench},
+  {"uss", cmd_uss},
+  {"display", cmd_display},
+  {"tare", cmd_tare},
   {"help", cmd_help},
   //{"tree", cmd_tree},
   {NULL, NULL}
@@ -44,9 +59,83 @@ static void cmd_help(BaseSequentialStream *lchp, int argc,const char * const arg
   chprintf (lchp, "  mem:\r\n");
   chprintf (lchp, "  threads: info about threads\r\n");
   chprintf (lchp, "  uid: get chip unique ID\r\n");
+  chprintf (lchp, "  sensors [reset]: sensors acquisition timings\r\n");
+  chprintf (lchp, "  bench [iterations]: cycle count of float heavy functions\r\n");
+  chprintf (lchp, "  uss [reset]: USS bus statistics\r\n");
+  chprintf (lchp, "  display: display command queue statistics\r\n");
+  chprintf (lchp, "  tare [show|clear|gain <gain>]: differential pressure zero, fan stopped\r\n");
   chprintf (lchp, "  help: get help\r\n");
 }
 
+static void cmd_sensors(BaseSequentialStream *lchp, int argc,const char * const argv[]) {
+  if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+    resetSensorStats();
+    return;
+  }
+  if (argc > 0) {
+    chprintf (lchp, "Usage: sensors [reset]\r\n");
+    return;
+  }
+  printSensorStats(lchp);
+}
+
+static void cmd_bench(BaseSequentialStream *lchp, int argc,const char * const argv[]) {
+  if (argc > 1) {
+    chprintf (lchp, "Usage: bench [iterations]\r\n");
+    return;
+  }
+  const uint32_t iterations = argc == 1 ? strtoul(argv[0], NULL, 10) : 1000;
+  runBenchmarks(lchp, iterations > 0 ? iterations : 1);
+}
+
+static void cmd_uss(BaseSequentialStream *lchp, int argc,const char * const argv[]) {
+  if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+    resetUSSStats();
+    return;
+  }
+  if (argc > 0) {
+    chprintf (lchp, "Usage: uss [reset]\r\n");
+    return;
+  }
+  printUSSStats(lchp);
+}
+
+static void cmd_display(BaseSequentialStream *lchp, int argc,const char * const argv[]) {
+  (void)argv;
+  if (argc > 0) {
+    chprintf (lchp, "Usage: display\r\n");
+    return;
+  }
+  printDisplayStats(lchp);
+}
+
+static void cmd_tare(BaseSequentialStream *lchp, int argc,const char * const argv[]) {
+  CalibStatus status;
+  if (argc == 0) {
+    chprintf (lchp, "averaging %u samples...\r\n", TARE_SAMPLES);
+    status = tareDp(TARE_SAMPLES);
+  } else if (argc == 1 && strcmp(argv[0], "show") == 0) {
+    printCalibration(lchp);
+    return;
+  } else if (argc == 1 && strcmp(argv[0], "clear") == 0) {
+    status = clearCalibration();
+  } else if (argc == 2 && strcmp(argv[0], "gain") == 0) {
+    const float gain = strtof(argv[1], NULL);
+    if (!(gain > 0.0f)) {
+      chprintf (lchp, "invalid gain\r\n");
+      return;
+    }
+    status = setDpGain(gain);
+  } else {
+    chprintf (lchp, "Usage: tare [show|clear|gain <gain>]\r\n");
+    return;
+  }
+  printCalibration(lchp);
+  if (status != CALIB_OK) {
+    chprintf (lchp, "%s\r\n", calibStatusString(status));
+  }
+}
+
 
 /*===========================================================================*/
 /* START OF PRIVATE SECTION  : DO NOT CHANGE ANYTHING BELOW THIS LINE        */
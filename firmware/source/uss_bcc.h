@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// USS block check character: XOR of all the telegram bytes before it.
+// The XOR of a telegram including its BCC is 0.
+
+/**
+ * Reference implementation, one byte per iteration.
+ */
+static inline uint8_t ussBccBytes(const uint8_t* p, size_t n) {
+    uint8_t bcc = 0;
+    for(size_t i=0; i<n; i++) {
+        bcc ^= p[i];
+    }
+    return bcc;
+}
+
+/**
+ * Same result, 4 bytes per iteration. The buffers may be unaligned
+ * (packed telegrams), the Cortex-M7 loads unaligned words natively.
+ */
+static inline uint8_t ussBccWords(const uint8_t* p, size_t n) {
+    uint32_t acc = 0;
+    size_t i = 0;
+    for(; i+4 <= n; i+=4) {
+        uint32_t w;
+        memcpy(&w, p + i, sizeof(w));
+        acc ^= w;
+    }
+    acc ^= acc >> 16;
+    acc ^= acc >> 8;
+    uint8_t bcc = acc & 0xFF;
+    for(; i<n; i++) {
+        bcc ^= p[i];
+    }
+    return bcc;
+}
@@ -1,5 +1,8 @@
 #include "uss_handler.h"
 #include "USS.h"
+#include "uss_log.h"
+#include "uss_parser.h"
+#include "seqlock.h"
 #include "hal.h"
 #include "sdLog.h"
 #include "stdutil++.hpp"
@@ -7,84 +10,264 @@
 #include "ch.h"
 #include "string.h"
 
+void uss_msg_cb(USSDriver *ussp);
+static void fan_request_cb(USSDriver *ussp, uint8_t node, uint8_t* data);
+
+// In master mode the fan inverter is polled and commanded, otherwise the bus
+// is only listened to and logged.
+#define USS_MASTER FALSE
+#define USS_FAN_NODE 1
+#define USS_PKW_WORDS 4
+#define USS_PZD_WORDS 2
+
+// control words (STW)
+#define USS_STW_OFF 0x047E  // OFF1, ready to run
+#define USS_STW_ON  0x047F  // ON
+#define USS_FAN_REF_FREQ 50.0f    // Hz, inverter reference frequency (P2000)
+// a response follows its task within the response delay (20ms max)
+#define USS_RESPONSE_WINDOW TIME_MS2I(30)
+#define DRIVE_STATE_TIMEOUT TIME_MS2I(1000)
+
+static const uint8_t poll_nodes[] = {USS_FAN_NODE};
+static volatile uint16_t fan_stw = USS_STW_OFF;
+static volatile uint16_t fan_hsw = 0;
+
+static SeqLock<DriveState> drive_state;
+static DriveState drive = {};           // working copy, updated from the USS callback
+static bool fan_task_seen = false;      // listening: waiting for the response of the fan
+static systime_t fan_task_time = 0;
+
+// Telegrams are received in place into pool records: the driver always holds
+// the telegram of `rx_record` as DMA target, the other records are either free
+// or waiting to be logged.
 #define TLGM_NB 10
-Telegram_t tlgm_buffer[TLGM_NB];
-msg_t free_tlgm_queue[TLGM_NB];
-MAILBOX_DECL(mb_free_tlgms, free_tlgm_queue, TLGM_NB);
-msg_t filled_tlgm_queue[TLGM_NB];
-MAILBOX_DECL(mb_filled_tlgms, filled_tlgm_queue, TLGM_NB);
-
-static void init_queue() {
-    chMBReset(&mb_filled_tlgms);
-    chMBResumeX(&mb_filled_tlgms);
-    chMBReset(&mb_free_tlgms);
-    chMBResumeX(&mb_free_tlgms);
+
+// Second RS485 bus, on USART6 (PC6/PC7) with an auto-direction transceiver.
+// USART6 is the shell port by default, the bus needs in mcuconf.h:
+//  - STM32_UART_USE_USART6 TRUE and STM32_SERIAL_USE_USART6 FALSE
+//  - STM32_GPT_USE_TIM7 TRUE (TIM2 is the system tick)
+//  - the shell on USB: CONSOLE_DEV_USB TRUE and STM32_USB_USE_OTG1 TRUE,
+//    with HAL_USE_USB TRUE in halconf.h
+#define USS_AUX_BUS FALSE
+
+#if USS_AUX_BUS
+#if !STM32_UART_USE_USART6 || STM32_SERIAL_USE_USART6
+#error "USS_AUX_BUS needs USART6 on the UART driver instead of the serial driver"
+#endif
+#if !STM32_GPT_USE_TIM7
+#error "USS_AUX_BUS needs STM32_GPT_USE_TIM7"
+#endif
+#endif
+
+typedef struct {
+    const char* name;           // log file prefix
+    USSConfig config;
+    bool fan;                   // the fan inverter is on this bus
+    // log pool
+    msg_t free_queue[TLGM_NB];
+    msg_t filled_queue[TLGM_NB];
+    mailbox_t mb_free;
+    mailbox_t mb_filled;
+    UssLogRecord* rx_record;
+    uint32_t pool_drops;        // telegrams not logged, no free buffer
+    // logger
+    FileDes log_fd;
+    bool log_opened;
+    thread_t* log_thd;
+} UssBus;
+
+// runtime fields zero initialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static UssBus uss_buses[] = {
+    {
+        .name = "USS",
+        .config = {
+            .uartp = &UARTD1,
+            .rs485_en_line = LINE_TX485EN,
+            .gpt = &GPTD5,
+            .speed = USS_MASTER ? 187500 : 115200,
+            .node_nb = 0,       // TODO
+            .standard_cb = NULL,
+            .broadcast_cb = NULL,
+            .special_cb = NULL,
+            .any_cb = uss_msg_cb,
+            .silent = false,
+            .user_data = &uss_buses[0],
+            .mode = USS_MASTER ? USS_MODE_MASTER : USS_MODE_SLAVE,
+            .poll_nodes = poll_nodes,
+            .nb_poll_nodes = sizeof(poll_nodes),
+            .pkw_words = USS_PKW_WORDS,
+            .pzd_words = USS_PZD_WORDS,
+            .request_cb = fan_request_cb,
+        },
+        .fan = true,
+    },
+#if USS_AUX_BUS
+    {
+        .name = "USSAUX",
+        .config = {
+            .uartp = &UARTD6,
+            .rs485_en_line = PAL_NOLINE,
+            .gpt = &GPTD7,
+            .speed = 19200,
+            .node_nb = 0,
+            .standard_cb = NULL,
+            .broadcast_cb = NULL,
+            .special_cb = NULL,
+            .any_cb = uss_msg_cb,
+            .silent = true,
+            .user_data = &uss_buses[1],
+            .mode = USS_MODE_SLAVE,
+            .poll_nodes = NULL,
+            .nb_poll_nodes = 0,
+            .pkw_words = USS_PKW_WORDS,
+            .pzd_words = USS_PZD_WORDS,
+            .request_cb = NULL,
+        },
+        .fan = false,
+    },
+#endif
+};
+#pragma GCC diagnostic pop
+
+#define USS_BUS_NB (sizeof(uss_buses)/sizeof(uss_buses[0]))
+
+static IN_DMA_SECTION(USSDriver uss_drivers[USS_BUS_NB]);
+static IN_DMA_SECTION(UssLogRecord uss_records[USS_BUS_NB][TLGM_NB]);
+static THD_WORKING_AREA(waUSSLoggers[USS_BUS_NB], 1024);
+
+static void init_queue(UssBus* bus, UssLogRecord* records) {
+    chMBObjectInit(&bus->mb_free, bus->free_queue, TLGM_NB);
+    chMBObjectInit(&bus->mb_filled, bus->filled_queue, TLGM_NB);
     // Pre-filling the free buffers pool with the available buffers, the post
     // will not stop because the mailbox is large enough.
-    for(int i=0; i<TLGM_NB; i++) {
-        chMBPostTimeout(&mb_free_tlgms, (msg_t)&tlgm_buffer[i], 0);
+    // The first buffer is given to the driver (rx_record).
+    bus->rx_record = &records[0];
+    for(int i=1; i<TLGM_NB; i++) {
+        chMBPostTimeout(&bus->mb_free, (msg_t)&records[i], 0);
     }
 }
 
+/**
+ * Decode the telegrams of the fan inverter.
+ * In master mode only the responses are received, when listening the task
+ * and its response are told apart by their order.
+ */
+static void updateDriveState(USSDriver *ussp) {
+    UssNetData nd;
+    if(ussp->status != USS_OK ||
+       !ussParseNetData(ussp->rxTelegram, ussp->config->pkw_words, ussp->config->pzd_words, &nd) ||
+       nd.node != USS_FAN_NODE || nd.pzd_words < 2) {
+        return;
+    }
 
-void uss_msg_cb(USSDriver *ussp);
-
-FileDes log_uss_fd;
-
-USSConfig ussconf = {
-    .uartp = &UARTD1,
-    .rs485_en_line = LINE_TX485EN,
-    .gpt = &GPTD5,
-    .speed = 115200,
-    .node_nb = 0,       // TODO
-    .standard_cb = NULL,
-    .broadcast_cb = NULL,
-    .special_cb = NULL,
-    .any_cb = uss_msg_cb,
-    .silent = false,
-    .user_data = NULL,
-};
-
-static IN_DMA_SECTION(USSDriver ussd);
+    bool response;
+    if(ussp->config->mode == USS_MODE_MASTER) {
+        response = true;
+        drive.control_word = fan_stw;
+        drive.setpoint = ussPzdToPercent(fan_hsw) * (USS_FAN_REF_FREQ / 100.0f);
+    } else {
+        response = fan_task_seen && chTimeDiffX(fan_task_time, ussp->rxTime) < USS_RESPONSE_WINDOW;
+        fan_task_seen = !response;
+        fan_task_time = ussp->rxTime;
+    }
 
+    if(response) {
+        drive.time = ussp->rxTime;
+        drive.status_word = nd.pzd[USS_PZD_ZSW];
+        drive.actual = ussPzdToPercent(nd.pzd[USS_PZD_HIW]) * (USS_FAN_REF_FREQ / 100.0f);
+        drive.valid = true;
+        drive_state.writeFromISR(drive);
+    } else {
+        drive.control_word = nd.pzd[USS_PZD_STW];
+        drive.setpoint = ussPzdToPercent(nd.pzd[USS_PZD_HSW]) * (USS_FAN_REF_FREQ / 100.0f);
+    }
+}
 
-bool uss_log_opened = false;
+DriveState getDriveState() {
+    DriveState state = drive_state.read();
+    if(chTimeDiffX(state.time, chVTGetSystemTimeX()) > DRIVE_STATE_TIMEOUT) {
+        state.valid = false;
+    }
+    return state;
+}
 
 void uss_msg_cb(USSDriver *ussp) {
-    Telegram_t* tlgm;
-    // get a free telegram
+    UssBus* bus = (UssBus*)ussp->config->user_data;
+    if(bus->fan) {
+        updateDriveState(ussp);
+    }
+
+    if(!bus->log_opened) {
+        // nobody to hand the telegram to, the driver reuses its buffer
+        return;
+    }
+    UssLogRecord* fresh;
     chSysLockFromISR();
-    msg_t ret = chMBFetchI(&mb_free_tlgms, (msg_t*)&tlgm);
+    // get a free record to receive the next telegrams
+    msg_t ret = chMBFetchI(&bus->mb_free, (msg_t*)&fresh);
     if(ret == MSG_OK) {
-        // copy data
-        memcpy(&tlgm, &ussp->rxTelegram, ussp->rxTelegram.lge+2);
-        // post it to the filled queue
-        chMBPostI(&mb_filled_tlgms, (msg_t)&tlgm);
+        UssLogRecord* rec = bus->rx_record;
+        rec->header.magic = USS_LOG_MAGIC;
+        rec->header.length = rec->tlgm.lge + 2;
+        rec->header.status = ussp->status;
+        rec->header.time = ussp->rxTime;
+        rec->header.cycles = ussp->rxCycles;
+        // take the received telegram, no copy
+        ussSwapRxTelegramI(ussp, &fresh->tlgm);
+        bus->rx_record = fresh;
+        // post it to the filled queue, never full: TLGM_NB buffers in total
+        chMBPostI(&bus->mb_filled, (msg_t)rec);
+    } else {
+        bus->pool_drops++;
     }
     chSysUnlockFromISR();
 }
 
 
-THD_WORKING_AREA(waUSSLogger, 1024);
-void uss_log(void*) {
+static void fan_request_cb(USSDriver *ussp, uint8_t node, uint8_t* data) {
+    (void)ussp;
+    (void)node;
+    // PKW: no task
+    uint8_t* pzd = data + 2*USS_PKW_WORDS;
+    ussWriteWord(pzd + 2*USS_PZD_STW, fan_stw);
+    ussWriteWord(pzd + 2*USS_PZD_HSW, fan_hsw);
+}
+
+void setFanCommand(bool run, float setpoint) {
+    if(setpoint < 0) {
+        setpoint = 0;
+    } else if(setpoint > 100) {
+        setpoint = 100;
+    }
+    fan_hsw = ussPercentToPzd(setpoint);
+    fan_stw = run ? USS_STW_ON : USS_STW_OFF;
+}
+
+
+void uss_log(void* arg) {
+    UssBus* bus = (UssBus*)arg;
     chRegSetThreadName("USS logger");
     while(!chThdShouldTerminateX()) {
-        Telegram_t* tlgm;
-        // get a filled telegram
-        msg_t ret = chMBFetchTimeout(&mb_filled_tlgms, (msg_t*)&tlgm, chTimeMS2I(100));
-        if(ret == MSG_OK && uss_log_opened) {
-            sdLogWriteRaw(log_uss_fd, (uint8_t*)tlgm, tlgm->lge+2);
+        UssLogRecord* rec;
+        // get a filled record
+        msg_t ret = chMBFetchTimeout(&bus->mb_filled, (msg_t*)&rec, chTimeMS2I(100));
+        if(ret == MSG_OK) {
+            sdLogWriteRaw(bus->log_fd, (uint8_t*)rec, sizeof(rec->header) + rec->header.length);
             // post the buffer back to free telegrams
-            chMBPostTimeout(&mb_free_tlgms, (msg_t)tlgm, TIME_IMMEDIATE);
+            chMBPostTimeout(&bus->mb_free, (msg_t)rec, TIME_IMMEDIATE);
         }
     }
+    // give back the records not logged
+    UssLogRecord* rec;
+    while(chMBFetchTimeout(&bus->mb_filled, (msg_t*)&rec, TIME_IMMEDIATE) == MSG_OK) {
+        chMBPostTimeout(&bus->mb_free, (msg_t)rec, TIME_IMMEDIATE);
+    }
 }
 
-thread_t* uss_log_thd = NULL;
-
 msg_t startUSSLog() {
-    init_queue();
-    if(uss_log_opened) {
+    if(isLoggingUSS()) {
         //already started
         return MSG_OK;
     }
@@ -92,31 +275,106 @@ msg_t startUSSLog() {
         return MSG_RESET;
     }
 
-    if(sdLogOpenLog(&log_uss_fd, "USS", "std", 1, false, 0, false) != SDLOG_OK) {
-        DebugTrace("SD fail to open USS logfile");
-        return MSG_RESET;
+    for(size_t i=0; i<USS_BUS_NB; i++) {
+        UssBus* bus = &uss_buses[i];
+        if(sdLogOpenLog(&bus->log_fd, bus->name, "std", 1, false, 0, false) != SDLOG_OK) {
+            DebugTrace("SD fail to open %s logfile", bus->name);
+            stopUSSLog();
+            return MSG_RESET;
+        }
+        bus->log_opened = true;
+        bus->log_thd = chThdCreateStatic(waUSSLoggers[i], sizeof(waUSSLoggers[i]), NORMALPRIO-1, uss_log, bus);
     }
-    uss_log_opened = true;
-
-    uss_log_thd = chThdCreateStatic(waUSSLogger, sizeof(waUSSLogger), NORMALPRIO-1, uss_log, NULL);
 
     return MSG_OK;
 }
 
 void stopUSSLog() {
-    uss_log_opened = false;
-    sdLogCloseLog(log_uss_fd);
-    if(uss_log_thd) {
-        chThdTerminate(uss_log_thd);
-        chThdWait(uss_log_thd);
-        uss_log_thd = NULL;
+    for(size_t i=0; i<USS_BUS_NB; i++) {
+        UssBus* bus = &uss_buses[i];
+        if(!bus->log_opened) {
+            continue;
+        }
+        bus->log_opened = false;
+        // the logger must be done with the file before closing it
+        if(bus->log_thd) {
+            chThdTerminate(bus->log_thd);
+            chThdWait(bus->log_thd);
+            bus->log_thd = NULL;
+        }
+        sdLogCloseLog(bus->log_fd);
     }
 }
 
 void startUSSListener() {
-    ussStart(&ussd, &ussconf);
+    for(size_t i=0; i<USS_BUS_NB; i++) {
+        UssBus* bus = &uss_buses[i];
+        init_queue(bus, uss_records[i]);
+        chSysLock();
+        ussSwapRxTelegramI(&uss_drivers[i], &bus->rx_record->tlgm);
+        chSysUnlock();
+        ussStart(&uss_drivers[i], &bus->config);
+    }
+}
+
+void setUSSBaudrate(uint32_t speed) {
+    // the fan is on the first bus
+    UssBus* bus = &uss_buses[0];
+    if(bus->config.speed == speed) {
+        return;
+    }
+    ussStop(&uss_drivers[0]);
+    bus->config.speed = speed;
+    ussStart(&uss_drivers[0], &bus->config);
+}
+
+uint32_t getUSSBaudrate() {
+    return uss_buses[0].config.speed;
+}
+
+void printUSSStats(BaseSequentialStream* lchp) {
+    for(size_t b=0; b<USS_BUS_NB; b++) {
+        UssBus* bus = &uss_buses[b];
+        USSStats st;
+        USSDelayStats ds;
+        ussGetStats(&uss_drivers[b], &st);
+        ussGetDelayStats(&uss_drivers[b], &ds);
+
+        chprintf(lchp, "%s, %lu bauds:\r\n", bus->name, bus->config.speed);
+        chprintf(lchp, "  telegrams: standard %lu, broadcast %lu, mirror %lu, special %lu\r\n",
+                 st.standard, st.broadcast, st.mirror, st.special);
+        chprintf(lchp, "  errors: bcc %lu, parity %lu, framing %lu, overrun %lu, noise %lu\r\n",
+                 st.bcc_errors, st.parity_errors, st.framing_errors, st.overrun_errors, st.noise_errors);
+        chprintf(lchp, "          rx timeout %lu, bad lge %lu, no response %lu, mirror drops %lu\r\n",
+                 st.timeouts, st.bad_lge, st.no_response, st.mirror_drops);
+        chprintf(lchp, "  log drops: %lu\r\n", bus->pool_drops);
+        chprintf(lchp, "  gap (us): min %lu, avg %lu, max %lu (%lu gaps)\r\n",
+                 st.gap_min_us, st.gaps ? (uint32_t)(st.gap_total_us / st.gaps) : 0, st.gap_max_us, st.gaps);
+
+        chprintf(lchp, "  tx delay (us): target %lu, min %lu, max %lu (%lu tx)\r\n",
+                 ds.target_us, ds.min_us, ds.max_us, ds.count);
+        for(size_t i=0; i<USS_DELAY_HIST_BINS; i++) {
+            if(ds.hist[i]) {
+                chprintf(lchp, "    +%2u us%s %lu\r\n", (unsigned)(i * USS_DELAY_HIST_WIDTH_US),
+                         i == USS_DELAY_HIST_BINS - 1 ? "+" : " ", ds.hist[i]);
+            }
+        }
+    }
+}
+
+void resetUSSStats() {
+    for(size_t b=0; b<USS_BUS_NB; b++) {
+        ussResetStats(&uss_drivers[b]);
+        ussResetDelayStats(&uss_drivers[b]);
+        uss_buses[b].pool_drops = 0;
+    }
 }
 
 bool isLoggingUSS() {
-  return uss_log_opened;
+    for(size_t b=0; b<USS_BUS_NB; b++) {
+        if(uss_buses[b].log_opened) {
+            return true;
+        }
+    }
+    return false;
 }
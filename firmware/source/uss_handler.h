@@ -1,8 +1,44 @@
 #pragma once
 #include "ch.h"
+#include "hal.h"
+
+// State of the fan inverter, decoded from its USS telegrams
+typedef struct {
+    systime_t time;         // reception time of the last response
+    uint16_t status_word;   // ZSW
+    uint16_t control_word;  // STW of the last task
+    float setpoint;         // main setpoint, Hz
+    float actual;           // actual frequency, Hz
+    bool valid;             // false if no response was received for a while
+} DriveState;
 
 msg_t startUSSLog();
 void stopUSSLog();
 
 void startUSSListener();
 bool isLoggingUSS();
+
+/**
+ * Command of the fan inverter, sent in USS master mode.
+ * @param run       ON if true, OFF1 otherwise
+ * @param setpoint  frequency setpoint, in % of the inverter reference frequency
+ */
+void setFanCommand(bool run, float setpoint);
+
+/**
+ * Last fan inverter state, lock free.
+ */
+DriveState getDriveState();
+
+/**
+ * Change the baud rate of the fan bus: the bus is stopped and restarted,
+ * its statistics are reset.
+ */
+void setUSSBaudrate(uint32_t speed);
+uint32_t getUSSBaudrate();
+
+/**
+ * Print the USS bus statistics and the response delay distribution.
+ */
+void printUSSStats(BaseSequentialStream* lchp);
+void resetUSSStats();
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include "USS.h"
+
+// Binary USS log format
+// The log file is a sequence of records, one per captured telegram:
+//   header | telegram bytes (STX, LGE, ADR, data..., BCC)
+// The telegram is `length` bytes long, records are not aligned. The magic lets
+// the decoder resynchronise after a corrupted record.
+// All fields are little endian. See tools/uss_log_parse.py for the decoder.
+
+#define USS_LOG_MAGIC 0x5355    // "US"
+
+typedef struct {
+    uint16_t magic;         // USS_LOG_MAGIC
+    uint8_t length;         // number of telegram bytes following the header
+    uint8_t status;         // USSError of the reception
+    uint32_t time;          // system time at STX, in ticks (CH_CFG_ST_FREQUENCY)
+    uint32_t cycles;        // realtime counter at STX, in CPU cycles
+} __attribute__((packed)) UssLogRecordHeader;
+
+static_assert(sizeof(UssLogRecordHeader) == 12, "UssLogRecordHeader layout changed, update tools/uss_log_parse.py");
+
+typedef struct {
+    UssLogRecordHeader header;
+    Telegram_t tlgm;
+} __attribute__((packed)) UssLogRecord;
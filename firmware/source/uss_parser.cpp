@@ -0,0 +1,31 @@
+#include "uss_parser.h"
+
+bool ussParseNetData(const Telegram_t* tlgm, uint8_t pkw_words, uint8_t pzd_words, UssNetData* out) {
+    // ADR + net data + BCC
+    if((pkw_words != 0 && pkw_words != 3 && pkw_words != 4) ||
+       pzd_words > USS_PZD_MAX || tlgm->lge != 2*(pkw_words + pzd_words) + 2) {
+        return false;
+    }
+    const uint8_t* p = tlgm->data;
+
+    out->node = tlgm->adr & 0x1F;
+    out->pkw_words = pkw_words;
+    if(pkw_words != 0) {
+        uint16_t pke = ussReadWord(p);
+        out->pkw.ak = pke >> 12;
+        out->pkw.sp = (pke >> 11) & 1;
+        out->pkw.pnu = pke & 0x7FF;
+        out->pkw.ind = ussReadWord(p + 2);
+        out->pkw.pwe = ussReadWord(p + 4);
+        if(pkw_words == 4) {
+            out->pkw.pwe = (out->pkw.pwe << 16) | ussReadWord(p + 6);
+        }
+    }
+    p += 2*pkw_words;
+
+    out->pzd_words = pzd_words;
+    for(uint8_t i=0; i<pzd_words; i++) {
+        out->pzd[i] = ussReadWord(p + 2*i);
+    }
+    return true;
+}
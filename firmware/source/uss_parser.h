@@ -0,0 +1,79 @@
+#pragma once
+#include "USS.h"
+
+// Decoding of the USS net data: PKW (parameter) area then PZD (process data)
+// area, both made of big endian 16 bits words.
+// The area lengths are not in the telegram, they are configured identically
+// on the master and the drives.
+
+#define USS_PZD_MAX 16
+
+// PZD words of the fan inverter
+#define USS_PZD_STW 0   // task: control word
+#define USS_PZD_HSW 1   // task: main setpoint
+#define USS_PZD_ZSW 0   // response: status word
+#define USS_PZD_HIW 1   // response: main actual value
+
+// status word (ZSW) bits
+#define USS_ZSW_READY_TO_SWITCH_ON  (1 << 0)
+#define USS_ZSW_READY               (1 << 1)
+#define USS_ZSW_RUNNING             (1 << 2)
+#define USS_ZSW_FAULT               (1 << 3)
+#define USS_ZSW_WARNING             (1 << 7)
+
+// setpoint and actual values: 0x4000 is 100% of the reference value
+#define USS_PZD_100_PERCENT 0x4000
+
+typedef struct {
+    uint8_t ak;         // task (pwe_ak_task_t) or response (pwe_ak_rps_t) id
+    bool sp;            // parameter change report
+    uint16_t pnu;       // parameter number
+    uint16_t ind;       // index
+    uint32_t pwe;       // parameter value. With 4 PKW words: PWE1 (high) and PWE2 (low)
+} UssPkw;
+
+typedef struct {
+    uint8_t node;
+    uint8_t pkw_words;  // 0 if no PKW area
+    UssPkw pkw;
+    uint8_t pzd_words;
+    uint16_t pzd[USS_PZD_MAX];
+} UssNetData;
+
+/**
+ * Split the net data of a received telegram in PKW and PZD areas.
+ * @param pkw_words     PKW area length, in words (0, 3 or 4)
+ * @param pzd_words     PZD area length, in words (0 to USS_PZD_MAX)
+ * @return false if the area lengths are out of range or if the telegram length
+ *         does not match them
+ */
+bool ussParseNetData(const Telegram_t* tlgm, uint8_t pkw_words, uint8_t pzd_words, UssNetData* out);
+
+static inline uint16_t ussReadWord(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void ussWriteWord(uint8_t* p, uint16_t w) {
+    p[0] = w >> 8;
+    p[1] = w & 0xFF;
+}
+
+static inline float ussPzdToPercent(uint16_t w) {
+    return (int16_t)w * (100.0f / USS_PZD_100_PERCENT);
+}
+
+/**
+ * Rounded to the nearest word, saturated to the -200% to +200% range.
+ */
+static inline uint16_t ussPercentToPzd(float percent) {
+    float w = percent * (USS_PZD_100_PERCENT / 100.0f);
+    // the conversion of a float out of the int16_t range is undefined
+    if(w >= INT16_MAX) {
+        w = INT16_MAX;
+    } else if(w <= INT16_MIN) {
+        w = INT16_MIN;
+    } else if(w != w) {
+        w = 0;          // NaN
+    }
+    return (uint16_t)(int16_t)(w < 0 ? w - 0.5f : w + 0.5f);
+}
@@ -0,0 +1,126 @@
+#include "uss_port.h"
+#include "USS.h"
+
+// USS port on the ChibiOS UART and GPT drivers
+// The end of the telegrams is checked by the USART receiver timeout, the GPT
+// only times the transmissions.
+
+#define USS_RTO_MAX 0xFFFFFF        // USART_RTOR.RTO, in bits
+
+// Checked for the recommended data rates and the bus speeds in use:
+// the response delay / start interval is at least 2 characters, less than
+// one timer tick longer, and far below the 20ms maximum response delay.
+static constexpr bool txDelayValid(uint32_t speed) {
+    return (uint64_t)ussBitsToTicks(USS_TX_DELAY_BITS, speed, USS_GPT_FREQ) * speed >= (uint64_t)USS_TX_DELAY_BITS * USS_GPT_FREQ &&
+           ((uint64_t)ussBitsToTicks(USS_TX_DELAY_BITS, speed, USS_GPT_FREQ) - 1) * speed < (uint64_t)USS_TX_DELAY_BITS * USS_GPT_FREQ &&
+           (uint64_t)ussBitsToTicks(USS_TX_DELAY_BITS, speed, USS_GPT_FREQ) * 1000 < 20ULL * USS_GPT_FREQ;
+}
+static_assert(txDelayValid(9600), "USS timing at 9600 bauds");
+static_assert(txDelayValid(19200), "USS timing at 19200 bauds");
+static_assert(txDelayValid(38400), "USS timing at 38400 bauds");
+static_assert(txDelayValid(115200), "USS timing at 115200 bauds");
+static_assert(txDelayValid(187500), "USS timing at 187500 bauds");
+// the receiver timeout is counted in bits, whatever the speed
+static_assert(USS_RX_IDLE_BITS <= USS_RTO_MAX, "USS receiver timeout does not fit in RTOR");
+static_assert(USS_RX_IDLE_BITS >= 11, "USS receiver timeout shorter than a character");
+
+static void char_received(UARTDriver *uartp, uint16_t c) {
+    ussRxChar((USSDriver*)uartp->ussp, (uint8_t)c);
+}
+
+static void telegram_received(UARTDriver *uartp) {
+    ussRxEnd((USSDriver*)uartp->ussp);
+}
+
+static void error_cb(UARTDriver *uartp, uartflags_t e) {
+    uint32_t errors = 0;
+    if(e & UART_PARITY_ERROR) {
+        errors |= USS_RX_ERR_PARITY;
+    }
+    if(e & UART_FRAMING_ERROR) {
+        errors |= USS_RX_ERR_FRAMING;
+    }
+    if(e & UART_OVERRUN_ERROR) {
+        errors |= USS_RX_ERR_OVERRUN;
+    }
+    if(e & UART_NOISE_ERROR) {
+        errors |= USS_RX_ERR_NOISE;
+    }
+    ussRxError((USSDriver*)uartp->ussp, errors);
+}
+
+static void telegram_sent(UARTDriver *uartp) {
+    ussTxEnd((USSDriver*)uartp->ussp);
+}
+
+static void rx_timeout_cb(UARTDriver *uartp) {
+    ussRxIdle((USSDriver*)uartp->ussp);
+}
+
+static void timeout_cb(GPTDriver *gptp) {
+    ussTimeout((USSDriver*)gptp->ussp);
+}
+
+void ussPortStart(USSDriver* ussp) {
+    const USSConfig* usscfg = ussp->config;
+    UssPort* port = &ussp->port;
+
+    // UART driver config
+    port->uartConfig.txend1_cb = NULL;                // End of transmission buffer callback.
+    port->uartConfig.txend2_cb = telegram_sent;       //Physical end of transmission callback.
+    port->uartConfig.rxend_cb = telegram_received;    //Receive buffer filled callback.
+    port->uartConfig.rxchar_cb = char_received;       //Character received while out if the @p UART_RECEIVE state.
+    port->uartConfig.rxerr_cb = error_cb;             //Receive error callback.
+    port->uartConfig.timeout_cb = rx_timeout_cb;      //Receiver timeout callback.
+    port->uartConfig.timeout = USS_RX_IDLE_BITS;      //Receiver timeout, in bits.
+    port->uartConfig.speed = usscfg->speed;
+    port->uartConfig.cr1 = USART_CR1_PCE | USART_CR1_M_0;   // parity enabled | 9 bits (including parity bit)
+    port->uartConfig.cr2 = USART_CR2_STOP1_BITS | USART_CR2_LINEN | USART_CR2_RTOEN;
+    port->uartConfig.cr3 = 0;
+
+    // GPT driver config
+    port->gptConfig.frequency = USS_GPT_FREQ;
+    port->gptConfig.callback = timeout_cb;
+    port->gptConfig.cr2 = 0;
+    port->gptConfig.dier = 0;
+
+    usscfg->uartp->ussp = ussp;
+    usscfg->gpt->ussp = ussp;
+    ussPortSetTxEnable(ussp, false);
+    uartStart(usscfg->uartp, &port->uartConfig);
+    gptStart(usscfg->gpt, &port->gptConfig);
+}
+
+void ussPortStop(USSDriver* ussp) {
+    uartStop(ussp->config->uartp);
+    gptStop(ussp->config->gpt);
+}
+
+void ussPortReceiveI(USSDriver* ussp, size_t n, uint8_t* buf) {
+    uartStartReceiveI(ussp->config->uartp, n, buf);
+}
+
+void ussPortStopReceiveI(USSDriver* ussp) {
+    uartStopReceiveI(ussp->config->uartp);
+}
+
+void ussPortStartTimeoutI(USSDriver* ussp, uint32_t bits) {
+    // rounded up to the next timer tick
+    gptStartOneShotI(ussp->config->gpt, ussBitsToTicks(bits, ussp->config->speed, USS_GPT_FREQ));
+}
+
+void ussPortSetTxEnable(USSDriver* ussp, bool enable) {
+    if(ussp->config->rs485_en_line == PAL_NOLINE) {
+        // transceiver with automatic direction control
+        return;
+    }
+    if(enable) {
+        palSetLine(ussp->config->rs485_en_line);
+    } else {
+        palClearLine(ussp->config->rs485_en_line);
+    }
+}
+
+void ussPortSendI(USSDriver* ussp, size_t n, const uint8_t* buf) {
+    uartStartSendI(ussp->config->uartp, n, buf);
+}
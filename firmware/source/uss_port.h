@@ -0,0 +1,46 @@
+#pragma once
+#include "hal.h"
+
+// Hardware port of the USS protocol engine (USS.cpp).
+// The engine only reaches the UART, the transmission timer and the RS485
+// direction line through the ussPort* functions, and the port drives the
+// engine through the ussRx* / ussTx* entry points, from its interrupts.
+// uss_port.cpp implements it on top of the ChibiOS UART and GPT drivers.
+// tests/uss_port_sim.cpp is a host port on a simulated bus with virtual time,
+// it replays recorded telegrams for the host tests. The kernel services (locks,
+// semaphores) are used directly, the host build gets them from tests/host.
+
+typedef struct USSDriver_private USSDriver;
+
+// 1MHz: the response delay is 117us at 187500 bauds
+#define USS_GPT_FREQ 1000000
+
+/**
+ * Timer ticks of a delay of `bits` bits, rounded up so that the delay is
+ * never shorter than required.
+ */
+static constexpr uint32_t ussBitsToTicks(uint32_t bits, uint32_t speed, uint32_t freq) {
+    return ((uint64_t)bits * freq + speed - 1) / speed;
+}
+
+typedef struct {
+    UARTConfig uartConfig;
+    GPTConfig gptConfig;
+} UssPort;
+
+// Port -> engine, called from ISR context (not locked)
+void ussRxChar(USSDriver* ussp, uint8_t c);     // character received outside of a telegram reception
+void ussRxEnd(USSDriver* ussp);                 // buffer given to ussPortReceiveI filled
+void ussRxError(USSDriver* ussp, uint32_t errors);  // USSRxErrorFlags
+void ussRxIdle(USSDriver* ussp);                // line idle for USS_RX_IDLE_BITS after a character
+void ussTimeout(USSDriver* ussp);               // timeout started with ussPortStartTimeoutI expired
+void ussTxEnd(USSDriver* ussp);                 // last character sent
+
+// Engine -> port
+void ussPortStart(USSDriver* ussp);
+void ussPortStop(USSDriver* ussp);
+void ussPortReceiveI(USSDriver* ussp, size_t n, uint8_t* buf);
+void ussPortStopReceiveI(USSDriver* ussp);
+void ussPortStartTimeoutI(USSDriver* ussp, uint32_t bits);  // one shot timeout after `bits` bit times, 1us resolution
+void ussPortSetTxEnable(USSDriver* ussp, bool enable);      // RS485 driver enable
+void ussPortSendI(USSDriver* ussp, size_t n, const uint8_t* buf);
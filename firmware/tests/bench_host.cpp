@@ -0,0 +1,117 @@
+// Host counterpart of the bench shell command (source/bench.cpp): same
+// workloads, timed with the host steady clock, in ns per call.
+#include "hal.h"
+#include "airspeed.h"
+#include "i2cPeriphSHT4x.h"
+#include "uss_port_sim.h"
+#include "uss_bcc.h"
+#include "fixed_format.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+static volatile uint16_t raw_in = 0x6666;
+static volatile float dp_in = 123.4f;
+static volatile float pressure_in = 101325.0f;
+static volatile float temp_in = 21.5f;
+static volatile float rh_in = 45.0f;
+static volatile float factor_in = 2.0f / AIR_DENSITY_STD;
+static volatile float sink_f;
+static volatile int sink_i;
+// longest telegram, at an unaligned offset like in the log records
+static uint8_t bcc_in[2 + 53];
+static volatile size_t bcc_len = 51;
+
+static USSDriver uss;
+static uint8_t tlgm_in[sizeof(Telegram_t) + 1];
+static size_t tlgm_len;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static const USSConfig uss_config = {
+    .uartp = NULL, .rs485_en_line = PAL_NOLINE, .gpt = NULL, .speed = 187500, .node_nb = 3,
+    .mode = USS_MODE_SLAVE,
+};
+#pragma GCC diagnostic pop
+
+/**
+ * Average ns per call of f, loop overhead removed.
+ */
+template <typename F>
+static double benchNs(uint32_t iterations, F f) {
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    for(uint32_t i=0; i<iterations; i++) {
+        (void)raw_in;
+    }
+    const double overhead = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+
+    t0 = clock::now();
+    for(uint32_t i=0; i<iterations; i++) {
+        (void)raw_in;
+        f();
+    }
+    const double total = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+    return total > overhead ? (total - overhead) / iterations : 0;
+}
+
+static void printBench(const char* name, double ns) {
+    printf("  %-24s %8.2f ns\n", name, ns);
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    printf("%u iterations\n", iterations);
+
+    printf("sensor conversion:\n");
+    printBench("sht4x temperature", benchNs(iterations, [] {
+        sink_f = sht4xRawToTemp(raw_in);
+    }));
+    printBench("sht4x humidity", benchNs(iterations, [] {
+        sink_f = sht4xRawToRH(raw_in);
+    }));
+
+    printf("airspeed:\n");
+    printBench("air density", benchNs(iterations, [] {
+        sink_f = airDensity(pressure_in, temp_in, rh_in);
+    }));
+    printBench("airspeed from dp", benchNs(iterations, [] {
+        sink_f = airspeedFromDp(dp_in, factor_in);
+    }));
+
+    printf("USS BCC, %u bytes:\n", (unsigned)bcc_len);
+    for(size_t i=0; i<sizeof(bcc_in); i++) {
+        bcc_in[i] = i * 37;
+    }
+    printBench("bytes loop", benchNs(iterations, [] {
+        sink_i = ussBccBytes(bcc_in + 2, bcc_len);
+    }));
+    printBench("words loop", benchNs(iterations, [] {
+        sink_i = ussBccWords(bcc_in + 2, bcc_len);
+    }));
+
+    static char buffer[16];
+    printf("formatting:\n");
+    printBench("snprintf %6.2f", benchNs(iterations, [] {
+        sink_i = snprintf(buffer, sizeof(buffer), "%6.2f", dp_in);
+    }));
+    printBench("fmtFloat 6, 2", benchNs(iterations, [] {
+        sink_i = fmtFloat(buffer, dp_in, 6, 2) - buffer;
+    }));
+
+    // standard telegram to the node, PKW and 2 PZD words
+    printf("USS engine, simulated bus:\n");
+    tlgm_in[0] = USS_STX;
+    tlgm_in[1] = 14;
+    tlgm_in[2] = 3;
+    tlgm_in[15] = ussBccBytes(tlgm_in, 15);
+    tlgm_len = 16;
+    ussSimReset(uss_config.speed);
+    ussStart(&uss, &uss_config);
+    printBench("16 bytes telegram", benchNs(iterations / 10, [] {
+        ussSimFeed(tlgm_in, tlgm_len, 0);
+        ussSimRunIdle();
+    }));
+    ussStop(&uss);
+    return uss.stats.standard == iterations / 10 ? 0 : 1;
+}
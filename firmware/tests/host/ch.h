@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Host stand-in for the ChibiOS/RT API used by the sources under test.
+// Single threaded: the system time and the realtime counter are a simulated
+// clock that only moves when a test sleeps or advances it. Threads are not
+// run, the lock only checks that the kernel API is called in the right state.
+
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef int32_t msg_t;
+typedef uint32_t rtcnt_t;
+typedef uint32_t tprio_t;
+typedef struct ch_thread thread_t;
+typedef void (*tfunc_t)(void*);
+
+typedef struct {
+    bool taken;
+} binary_semaphore_t;
+
+#define MSG_OK 0
+#define MSG_TIMEOUT -1
+#define MSG_RESET -2
+
+#define NORMALPRIO 128
+#define CH_CFG_ST_FREQUENCY 10000
+#define TIME_IMMEDIATE ((sysinterval_t)0)
+#define TIME_INFINITE ((sysinterval_t)-1)
+#define TIME_MS2I(ms) ((sysinterval_t)((ms) * (CH_CFG_ST_FREQUENCY / 1000)))
+#define TIME_US2I(us) ((sysinterval_t)(((us) * CH_CFG_ST_FREQUENCY + 999999) / 1000000))
+#define RTC2US(freq, n) ((((n) - 1UL) / ((freq) / 1000000UL)) + 1UL)
+
+#define THD_WORKING_AREA(s, n) uint8_t s[n]
+
+#define chDbgAssert(c, r) do { if(!(c)) { chSysHalt(r); } } while(0)
+
+extern systime_t sim_time;
+extern rtcnt_t sim_rtc;
+extern int sim_lock;
+
+/**
+ * Advance the simulated clock, the realtime counter runs at STM32_SYSCLK.
+ */
+void simAdvanceNs(uint64_t ns);
+
+[[noreturn]] void chSysHalt(const char* reason);
+
+static inline systime_t chVTGetSystemTimeX(void) { return sim_time; }
+static inline systime_t chVTGetSystemTime(void) { return sim_time; }
+static inline sysinterval_t chTimeDiffX(systime_t start, systime_t end) { return end - start; }
+static inline sysinterval_t chTimeUS2I(uint32_t us) { return TIME_US2I((uint64_t)us); }
+static inline rtcnt_t chSysGetRealtimeCounterX(void) { return sim_rtc; }
+static inline void chThdSleep(sysinterval_t delay) { sim_time += delay; }
+static inline void chThdSleepMilliseconds(uint32_t ms) { chThdSleep(TIME_MS2I(ms)); }
+
+// the kernel is not reentrant: no nesting, in thread or ISR context
+static inline void chSysLock(void) { chDbgAssert(sim_lock == 0, "chSysLock, already locked"); sim_lock++; }
+static inline void chSysUnlock(void) { chDbgAssert(sim_lock == 1, "chSysUnlock, not locked"); sim_lock--; }
+static inline void chSysLockFromISR(void) { chSysLock(); }
+static inline void chSysUnlockFromISR(void) { chSysUnlock(); }
+#define chDbgCheckClassI() chDbgAssert(sim_lock == 1, "I-class function called unlocked")
+
+static inline void chBSemObjectInit(binary_semaphore_t* bsp, bool taken) { bsp->taken = taken; }
+static inline void chBSemResetI(binary_semaphore_t* bsp, bool taken) { chDbgCheckClassI(); bsp->taken = taken; }
+static inline void chBSemSignalI(binary_semaphore_t* bsp) { chDbgCheckClassI(); bsp->taken = false; }
+static inline void chBSemSignal(binary_semaphore_t* bsp) { bsp->taken = false; }
+// nobody else can signal: a taken semaphore times out at once
+static inline msg_t chBSemWaitTimeout(binary_semaphore_t* bsp, sysinterval_t) {
+    if(bsp->taken) {
+        return MSG_TIMEOUT;
+    }
+    bsp->taken = true;
+    return MSG_OK;
+}
+static inline msg_t chBSemWaitTimeoutS(binary_semaphore_t* bsp, sysinterval_t timeout) {
+    chDbgAssert(sim_lock == 1, "S-class function called unlocked");
+    return chBSemWaitTimeout(bsp, timeout);
+}
+
+static inline void chRegSetThreadName(const char*) {}
+static inline bool chThdShouldTerminateX(void) { return true; }
+static inline thread_t* chThdCreateStatic(void*, size_t, tprio_t, tfunc_t, void*) {
+    chSysHalt("threads are not simulated");
+}
+static inline void chThdTerminate(thread_t*) {}
+static inline msg_t chThdWait(thread_t*) { return MSG_OK; }
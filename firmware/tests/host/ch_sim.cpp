@@ -0,0 +1,21 @@
+#include "hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+systime_t sim_time = 0;
+rtcnt_t sim_rtc = 0;
+int sim_lock = 0;
+
+static uint64_t sim_ns = 0;
+
+void simAdvanceNs(uint64_t ns) {
+    const uint64_t before = sim_ns;
+    sim_ns += ns;
+    sim_time += sim_ns / (1000000000 / CH_CFG_ST_FREQUENCY) - before / (1000000000 / CH_CFG_ST_FREQUENCY);
+    sim_rtc += sim_ns * (STM32_SYSCLK / 1000000) / 1000 - before * (STM32_SYSCLK / 1000000) / 1000;
+}
+
+void chSysHalt(const char* reason) {
+    fprintf(stderr, "chSysHalt: %s\n", reason);
+    abort();
+}
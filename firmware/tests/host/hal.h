@@ -0,0 +1,22 @@
+#pragma once
+#include "ch.h"
+
+// Host stand-in for the ChibiOS/HAL types used by the sources under test.
+// The drivers are opaque, the hardware is reached through host ports.
+
+#define STM32_SYSCLK 216000000
+
+typedef uint32_t ioline_t;
+#define PAL_NOLINE 0U
+
+typedef struct I2CDriver I2CDriver;
+typedef struct UARTDriver UARTDriver;
+typedef struct GPTDriver GPTDriver;
+
+typedef struct {
+    uint32_t speed;
+} UARTConfig;
+
+typedef struct {
+    uint32_t frequency;
+} GPTConfig;
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdio.h>
+#include <math.h>
+
+// Minimal checks for the host tests: failures are reported and counted,
+// the test keeps going and testResult() gives the process exit code.
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define CHECK_CLOSE(a, b, tol) do { \
+    double _a = (a), _b = (b); \
+    if(!(fabs(_a - _b) <= (tol))) { \
+        fprintf(stderr, "%s:%d: check failed: %s = %.6f, expected %.6f +- %g\n", \
+                __FILE__, __LINE__, #a, _a, _b, (double)(tol)); \
+        test_failures++; \
+    } \
+} while(0)
+
+static inline int testResult(const char* name) {
+    if(test_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
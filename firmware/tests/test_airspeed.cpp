@@ -0,0 +1,19 @@
+#include "airspeed.h"
+#include "test.h"
+
+int main() {
+    // reference values of moist air density tables
+    CHECK_CLOSE(airDensity(101325.0f, 20.0f, 50.0f), 1.1988, 5e-4);
+    CHECK_CLOSE(airDensity(101325.0f, 15.0f, 0.0f), 1.2250, 5e-4);
+    CHECK_CLOSE(airDensity(101325.0f, 15.0f, 0.0f), AIR_DENSITY_STD, 5e-4);
+    // humidity makes the air lighter
+    CHECK(airDensity(101325.0f, 30.0f, 90.0f) < airDensity(101325.0f, 30.0f, 0.0f));
+
+    const float factor = airspeedFactor(AIR_DENSITY_STD);
+    CHECK_CLOSE(airspeedFromDp(100.0f, factor), 12.78, 5e-3);
+    CHECK_CLOSE(airspeedFromDp(-100.0f, factor), -12.78, 5e-3);
+    CHECK(airspeedFromDp(0.0f, factor) == 0.0f);
+    CHECK_CLOSE(airspeedFromDp(400.0f, factor), 2 * airspeedFromDp(100.0f, factor), 1e-4);
+
+    return testResult("airspeed");
+}
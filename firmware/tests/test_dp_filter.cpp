@@ -0,0 +1,167 @@
+#include "dp_filter.h"
+#include "test.h"
+#include <stdlib.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+static DpFilterConfig config(DpFilterType type, uint8_t length, float alpha, uint8_t decimation) {
+    DpFilterConfig c;
+    c.type = type;
+    c.length = length;
+    c.alpha = alpha;
+    c.decimation = decimation;
+    return c;
+}
+
+// around `offset`, +-1Pa of noise
+static float sample(float offset) {
+    return offset + (rand() % 2001 - 1000) / 1000.0f;
+}
+
+// filter output after the last input, recomputed from the inputs
+static double reference(const DpFilterConfig& c, const std::vector<float>& in) {
+    const size_t n = std::min<size_t>(in.size(), c.length);
+    std::vector<float> window(in.end() - n, in.end());
+    switch (c.type)
+    {
+    case DP_FILTER_MOVING_AVERAGE: {
+        double sum = 0;
+        for(float v: window) {
+            sum += v;
+        }
+        return sum / n;
+    }
+    case DP_FILTER_MEDIAN:
+        std::sort(window.begin(), window.end());
+        return n & 1 ? window[n / 2] : 0.5f * (window[n / 2 - 1] + window[n / 2]);
+    case DP_FILTER_LOW_PASS: {
+        // same arithmetic as the filter, seeded with the first input
+        float y = in[0];
+        for(size_t i=1; i<in.size(); i++) {
+            y += c.alpha * (in[i] - y);
+        }
+        return y;
+    }
+    case DP_FILTER_NONE:
+    default:
+        return in.back();
+    }
+}
+
+// rounding of the moving average running sum, for samples up to `max`
+static double sumTolerance(float max) {
+    return DP_FILTER_MAX_LEN * FLT_EPSILON * max;
+}
+
+/**
+ * Every output against the reference, outputs every `decimation` inputs.
+ * @return the largest difference with the reference
+ */
+static double run(const DpFilterConfig& c, size_t nb, float offset) {
+    DpFilter f;
+    dpFilterInit(&f, &c);
+    // clamped parameters
+    const DpFilterConfig& fc = f.config;
+    std::vector<float> in;
+    double max_error = 0;
+    size_t outputs = 0;
+    for(size_t i=1; i<=nb; i++) {
+        in.push_back(sample(offset));
+        float out = NAN;
+        const bool produced = dpFilterPush(&f, in.back(), &out);
+        CHECK(produced == (i % fc.decimation == 0));
+        if(produced) {
+            outputs++;
+            max_error = std::max(max_error, fabs(out - reference(fc, in)));
+        }
+    }
+    CHECK(outputs == nb / fc.decimation);
+    return max_error;
+}
+
+static void testFilters() {
+    srand(8);
+    const DpFilterType types[] = {DP_FILTER_NONE, DP_FILTER_MOVING_AVERAGE, DP_FILTER_LOW_PASS, DP_FILTER_MEDIAN};
+    const uint8_t lengths[] = {1, 2, 5, 8, 31, DP_FILTER_MAX_LEN};
+    const uint8_t decimations[] = {1, 3, 10};
+    for(DpFilterType type: types) {
+        for(uint8_t length: lengths) {
+            for(uint8_t decimation: decimations) {
+                // the first outputs come from a partly filled ring
+                const double error = run(config(type, length, 0.1f, decimation), 3 * DP_FILTER_MAX_LEN + 7, 20.0f);
+                if(type == DP_FILTER_MOVING_AVERAGE) {
+                    CHECK(error < sumTolerance(21.0f));
+                } else {
+                    CHECK(error == 0);
+                }
+            }
+        }
+    }
+    for(float alpha: {0.01f, 0.5f, 1.0f}) {
+        CHECK(run(config(DP_FILTER_LOW_PASS, 1, alpha, 1), 1000, 20.0f) == 0);
+    }
+}
+
+static void testMovingAverageResync() {
+    // the running sum is recomputed once per window: after a large step, the
+    // rounding error of the large samples is gone within two windows
+    const DpFilterConfig c = config(DP_FILTER_MOVING_AVERAGE, 25, 0.1f, 1);
+    DpFilter f;
+    dpFilterInit(&f, &c);
+    srand(80);
+    std::vector<float> in;
+    float out;
+    for(int i=0; i<1000; i++) {
+        in.push_back(sample(100000.0f));
+        dpFilterPush(&f, in.back(), &out);
+    }
+    double max_error = 0;
+    for(int i=0; i<1000; i++) {
+        in.push_back(sample(0.0f));
+        dpFilterPush(&f, in.back(), &out);
+        if(i >= 2 * c.length) {
+            max_error = std::max(max_error, fabs(out - reference(c, in)));
+        }
+    }
+    CHECK(max_error < sumTolerance(1.0f));
+}
+
+static void testClamping() {
+    DpFilter f;
+    DpFilterConfig c = config(DP_FILTER_MEDIAN, 0, 0.0f, 0);
+    dpFilterInit(&f, &c);
+    CHECK(f.config.length == 1);
+    CHECK(f.config.alpha == 1.0f);
+    CHECK(f.config.decimation == 1);
+
+    c = config(DP_FILTER_MOVING_AVERAGE, DP_FILTER_MAX_LEN + 1, 1.5f, 255);
+    dpFilterInit(&f, &c);
+    CHECK(f.config.length == DP_FILTER_MAX_LEN);
+    CHECK(f.config.alpha == 1.0f);
+    CHECK(f.config.decimation == 255);
+
+    for(float alpha: {-0.5f, NAN, INFINITY}) {
+        c = config(DP_FILTER_LOW_PASS, 4, alpha, 2);
+        dpFilterInit(&f, &c);
+        CHECK(f.config.alpha == 1.0f);
+    }
+
+    // in range values are kept
+    c = config(DP_FILTER_LOW_PASS, DP_FILTER_MAX_LEN, 0.25f, 1);
+    dpFilterInit(&f, &c);
+    CHECK(f.config.length == DP_FILTER_MAX_LEN);
+    CHECK(f.config.alpha == 0.25f);
+
+    // the filter runs with the clamped parameters
+    srand(88);
+    CHECK(run(config(DP_FILTER_MOVING_AVERAGE, 200, 0.1f, 0), 100, 20.0f) < sumTolerance(21.0f));
+    CHECK(run(config(DP_FILTER_LOW_PASS, 0, 2.0f, 0), 100, 20.0f) == 0);
+}
+
+int main() {
+    testFilters();
+    testMovingAverageResync();
+    testClamping();
+    return testResult("dp_filter");
+}
@@ -0,0 +1,135 @@
+// fmtFixed and fmtFloat against snprintf("%*.*f").
+// `test_fixed_format exhaustive` goes through every int32_t and every float
+// bit pattern instead of the sampled ranges (about 50 minutes per decimals).
+#include "fixed_format.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int32_t pow10i[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+static int mismatches = 0;
+
+static void report(const char* fn, double value, int width, int decimals, const char* got, const char* expected) {
+    if(mismatches++ < 20) {
+        fprintf(stderr, "%s(%.9g, %d, %d): \"%s\", snprintf \"%s\"\n", fn, value, width, decimals, got, expected);
+    }
+    test_failures++;
+}
+
+static void checkFixed(int32_t value, int width, int decimals) {
+    char got[32], expected[32];
+    char* end = fmtFixed(got, value, width, decimals);
+    // the quotient is within 1 ulp of a number with `decimals` decimals,
+    // far from a rounding boundary
+    snprintf(expected, sizeof(expected), "%*.*f", width, decimals, (double)value / pow10i[decimals]);
+    if(strcmp(got, expected) != 0 || end != got + strlen(got)) {
+        report("fmtFixed", value, width, decimals, got, expected);
+    }
+}
+
+static void checkFloat(float value, int width, int decimals) {
+    char got[32], expected[48];
+    char* end = fmtFloat(got, value, width, decimals);
+    if(end != got + strlen(got)) {
+        report("fmtFloat", value, width, decimals, got, "end");
+        return;
+    }
+    const double scaled = (double)value * pow10i[decimals];
+    if(strstr(got, "---") != NULL) {
+        // out of range or not finite only
+        if(scaled > -1.99e9 && scaled < 1.99e9) {
+            report("fmtFloat", value, width, decimals, got, "in range");
+        }
+        return;
+    }
+    snprintf(expected, sizeof(expected), "%*.*f", width, decimals, (double)value);
+    if(strcmp(got, expected) != 0) {
+        report("fmtFloat", value, width, decimals, got, expected);
+    }
+}
+
+static float floatOf(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static void sampled(void) {
+    for(int decimals = 0; decimals <= FMT_FIXED_MAX_DECIMALS; decimals++) {
+        // fmtFixed: every value around zero, each power of ten, the extremes
+        for(int32_t v = -200000; v <= 200000; v++) {
+            checkFixed(v, 0, decimals);
+        }
+        for(int32_t p = 10; p <= 1000000000; p *= 10) {
+            for(int32_t d = -2; d <= 2; d++) {
+                checkFixed(p + d, 8, decimals);
+                checkFixed(-p + d, 8, decimals);
+            }
+        }
+        checkFixed(INT32_MAX, 0, decimals);
+        checkFixed(INT32_MIN, 0, decimals);
+
+        // fmtFloat: every exponent and sign, 2^20 patterns per decimals
+        for(uint32_t bits = decimals; bits < 0xFFFFFFFF - 4096; bits += 4096 + 1) {
+            checkFloat(floatOf(bits), 0, decimals);
+        }
+        // exact ties of the decimal rounding: k / 2^(decimals + 1)
+        for(int32_t k = -100000; k <= 100000; k++) {
+            checkFloat(ldexpf((float)k, -(decimals + 1)), 0, decimals);
+            checkFloat((float)k / pow10i[decimals] + 0.5f / pow10i[decimals], 0, decimals);
+        }
+        // values rounding to zero, and the non finite ones
+        checkFloat(-0.0f, 0, decimals);
+        checkFloat(-0.4f / pow10i[decimals], 0, decimals);
+        checkFloat(-0.5f / pow10i[decimals], 0, decimals);
+        checkFloat(1e-45f, 0, decimals);
+        checkFloat(INFINITY, 0, decimals);
+        checkFloat(-INFINITY, 0, decimals);
+        checkFloat(NAN, 0, decimals);
+    }
+
+    // the display formats, random values and widths
+    srand(22);
+    for(int i = 0; i < 1000000; i++) {
+        const float v = (rand() - RAND_MAX / 2) / 1000.0f;
+        const int width = rand() % 12;
+        checkFloat(v, width, rand() % (FMT_FIXED_MAX_DECIMALS + 1));
+        checkFixed(rand() - RAND_MAX / 2, width, rand() % (FMT_FIXED_MAX_DECIMALS + 1));
+    }
+
+    // buffer size of the header: max(width + 1, FMT_FIXED_MAX_LEN) bytes
+    for(uint8_t width = 0; width <= 20; width++) {
+        const size_t size = width + 1 > FMT_FIXED_MAX_LEN ? width + 1 : FMT_FIXED_MAX_LEN;
+        char buffer[32];
+        memset(buffer, 'x', sizeof(buffer));
+        char* end = fmtFixed(buffer, INT32_MIN, width, FMT_FIXED_MAX_DECIMALS);
+        CHECK(end < buffer + size && buffer[size] == 'x');
+        memset(buffer, 'x', sizeof(buffer));
+        end = fmtFloat(buffer, -2e9f, width, 0);
+        CHECK(end < buffer + size && buffer[size] == 'x');
+    }
+}
+
+static void exhaustive(int decimals) {
+    uint32_t bits = 0;
+    do {
+        checkFixed((int32_t)bits, 0, decimals);
+        checkFloat(floatOf(bits), 0, decimals);
+    } while(++bits != 0);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1 && strcmp(argv[1], "exhaustive") == 0) {
+        for(int decimals = 0; decimals <= FMT_FIXED_MAX_DECIMALS; decimals++) {
+            if(argc > 2 && atoi(argv[2]) != decimals) {
+                continue;
+            }
+            exhaustive(decimals);
+            printf("%d decimals: %d mismatches\n", decimals, mismatches);
+        }
+    } else {
+        sampled();
+    }
+    return testResult("fixed_format");
+}
@@ -0,0 +1,53 @@
+// Writes a sensor log the way the logger does (full blocks, then the
+// partially filled last one) for test_sensor_log_to_csv.py to decode.
+#include "sensor_log.h"
+#include "test.h"
+#include <string.h>
+
+#define NB_RECORDS 40
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s log_file\n", argv[0]);
+        return 2;
+    }
+    FILE* f = fopen(argv[1], "wb");
+    if(!f) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    static SensorLogBlock blk;
+    uint32_t seq = 0;
+    sensorLogBlockInit(&blk, seq);
+    CHECK(sensorLogBlockEmpty(&blk));
+
+    for(int i = 0; i < NB_RECORDS; i++) {
+        SensorLogRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.timestamp = 1000 + i * 100;
+        rec.flags = SENSOR_LOG_BMP3_OK | SENSOR_LOG_SDP3X_OK | SENSOR_LOG_SHT4X_OK
+                  | SENSOR_LOG_DP_FILTERED_OK | SENSOR_LOG_DRIVE_OK;
+        rec.updated = i % 2 ? SENSOR_LOG_SDP3X_OK : SENSOR_LOG_BMP3_OK;
+        rec.tunnel_temp = 20.0f + i * 0.25f;
+        rec.temp = 21.0f + i * 0.25f;
+        rec.diff_p = i * 1.5f;
+        rec.pressure = 1013.25f;
+        rec.diff_p_raw = i * 1.5f + 0.5f;
+        rec.fan_freq = i * 0.5f;
+        if(sensorLogBlockAppend(&blk, &rec)) {
+            CHECK(blk.header.count == SENSOR_LOG_RECORDS_PER_BLOCK);
+            fwrite(&blk, sizeof(blk), 1, f);
+            sensorLogBlockInit(&blk, ++seq);
+        }
+    }
+    if(!sensorLogBlockEmpty(&blk)) {
+        fwrite(&blk, sizeof(blk), 1, f);
+        seq++;
+    }
+    fclose(f);
+
+    CHECK(SENSOR_LOG_RECORDS_PER_BLOCK == 15);
+    CHECK(seq == 3);
+    return testResult("sensor_log");
+}
@@ -0,0 +1,30 @@
+#!/usr/bin/env python3
+"""Decode the log written by test_sensor_log with tools/sensor_log_to_csv.py."""
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "tools"))
+from sensor_log_to_csv import decode  # noqa: E402
+
+NB_RECORDS = 40
+
+
+def main():
+    with open(sys.argv[1], "rb") as f:
+        rows = list(decode(f, 10000))
+
+    assert len(rows) == NB_RECORDS, f"{len(rows)} rows decoded, expected {NB_RECORDS}"
+    for i, (columns, row) in enumerate(rows):
+        values = dict(zip(columns, row))
+        assert float(values["time"]) == (1000 + i * 100) / 10000, (i, values)
+        assert int(values["flags"]) == 0x1F, (i, values)
+        assert int(values["updated"]) == (2 if i % 2 else 1), (i, values)
+        assert float(values["tunnel_temp"]) == 20.0 + i * 0.25, (i, values)
+        assert float(values["diff_p"]) == i * 1.5, (i, values)
+        assert float(values["diff_p_raw"]) == i * 1.5 + 0.5, (i, values)
+        assert float(values["fan_freq"]) == i * 0.5, (i, values)
+    print("sensor_log_to_csv: ok")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+// Runs the sensor bus loop of sensors.cpp on a simulated clock that wraps
+// around during the test, and checks every task keeps its period.
+#include "sensor_scheduler.h"
+#include "test.h"
+
+#define SIM_DURATION TIME_MS2I(2000)
+
+typedef struct {
+    int triggers;
+    int fetches;
+    systime_t last_fetch;
+    bool fetched;
+    sysinterval_t max_gap;
+    sysinterval_t min_gap;
+    sysinterval_t max_latency;  // lateness of the fetch after trigger + conversion
+    systime_t triggered_at;
+} TaskLog;
+
+static TaskLog logs[3];
+static SensorTask* running;
+static sysinterval_t fetch_duration;   // simulated bus time of a fetch
+
+static TaskLog* logOf(SensorTask* task);
+
+static msg_t trigger(void) {
+    TaskLog* log = logOf(running);
+    log->triggers++;
+    log->triggered_at = chVTGetSystemTimeX();
+    return MSG_OK;
+}
+
+static msg_t fetch(void) {
+    TaskLog* log = logOf(running);
+    systime_t now = chVTGetSystemTimeX();
+    if(running->trigger != NULL) {
+        sysinterval_t latency = (sysinterval_t)(now - log->triggered_at) - running->conversion;
+        if(latency > log->max_latency) {
+            log->max_latency = latency;
+        }
+    }
+    if(log->fetched) {
+        sysinterval_t gap = now - log->last_fetch;
+        if(gap > log->max_gap) { log->max_gap = gap; }
+        if(gap < log->min_gap) { log->min_gap = gap; }
+    }
+    log->fetched = true;
+    log->last_fetch = now;
+    log->fetches++;
+    chThdSleep(fetch_duration);
+    return MSG_OK;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static SensorTask tasks[] = {
+    {.name = "bmp3", .period = TIME_MS2I(20), .conversion = TIME_MS2I(5), .trigger = trigger, .fetch = fetch},
+    {.name = "sdp3x", .period = TIME_MS2I(2), .conversion = 0, .trigger = NULL, .fetch = fetch},
+    {.name = "sht4x", .period = TIME_MS2I(100), .conversion = TIME_MS2I(9), .trigger = trigger, .fetch = fetch},
+};
+#pragma GCC diagnostic pop
+#define NB_TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+static TaskLog* logOf(SensorTask* task) {
+    return &logs[task - tasks];
+}
+
+// same loop as sensorBusThd()
+static void runBus(systime_t start, sysinterval_t duration) {
+    SensorScheduler sched;
+    for(size_t i = 0; i < NB_TASKS; i++) {
+        logs[i] = (TaskLog){};
+        logs[i].min_gap = TIME_INFINITE;
+    }
+    sim_time = start;
+    sensorSchedInit(&sched, tasks, NB_TASKS, chVTGetSystemTime());
+    while((sysinterval_t)(chVTGetSystemTime() - start) < duration) {
+        SensorTask* task = sensorSchedNext(&sched, chVTGetSystemTime());
+        sysinterval_t delay = sensorSchedTimeToDeadline(task, chVTGetSystemTime());
+        CHECK(delay <= task->period);
+        if(delay > 0) {
+            chThdSleep(delay);
+        }
+        running = task;
+        sensorSchedRun(task, chVTGetSystemTime());
+    }
+}
+
+int main() {
+    // the clock wraps 1s into the run
+    const systime_t start = (systime_t)0 - TIME_MS2I(1000);
+
+    // instantaneous bus: every task runs exactly on time
+    fetch_duration = 0;
+    runBus(start, SIM_DURATION);
+    for(size_t i = 0; i < NB_TASKS; i++) {
+        int expected = SIM_DURATION / tasks[i].period;
+        CHECK(logs[i].fetches >= expected - 1 && logs[i].fetches <= expected + 1);
+        CHECK(logs[i].min_gap == tasks[i].period);
+        CHECK(logs[i].max_gap == tasks[i].period);
+        CHECK(logs[i].max_latency == 0);
+    }
+    CHECK(logs[0].triggers == logs[0].fetches || logs[0].triggers == logs[0].fetches + 1);
+
+    // each fetch holds the bus 0.3ms: tasks are delayed by the others,
+    // but the period is kept on average and nobody starves
+    fetch_duration = TIME_US2I(300);
+    runBus(start, SIM_DURATION);
+    for(size_t i = 0; i < NB_TASKS; i++) {
+        int expected = SIM_DURATION / tasks[i].period;
+        CHECK(logs[i].fetches >= expected - 2 && logs[i].fetches <= expected + 1);
+        CHECK(logs[i].max_gap <= tasks[i].period + 3 * fetch_duration);
+        CHECK(logs[i].max_latency <= 3 * fetch_duration);
+    }
+
+    // a bus slower than the fastest period: sdp3x overruns and is rescheduled
+    // one period after the late fetch, the others keep running
+    fetch_duration = TIME_MS2I(3);
+    runBus(start, SIM_DURATION);
+    CHECK(logs[1].min_gap >= tasks[1].period);
+    CHECK(logs[1].fetches > 0);
+    for(size_t i = 0; i < NB_TASKS; i += 2) {
+        CHECK(logs[i].max_gap <= tasks[i].period + 2 * fetch_duration);
+        CHECK(logs[i].fetches >= (int)(SIM_DURATION / (tasks[i].period + 2 * fetch_duration)));
+    }
+
+    return testResult("sensor_scheduler");
+}
@@ -0,0 +1,322 @@
+// USS protocol engine (source/USS.cpp) on the simulated bus of uss_port_sim.
+#include "uss_port_sim.h"
+#include "uss_log.h"
+#include "uss_bcc.h"
+#include "test.h"
+#include <string.h>
+
+#define NODE 3
+
+typedef struct {
+    int standard;
+    int broadcast;
+    int special;
+    int any;
+    USSError status[32];        // status of each any_cb call
+    Telegram_t last;
+    uint64_t last_ns;           // time of the last any_cb call
+} Received;
+
+static Received received;
+static USSDriver uss;
+
+static void standard_cb(USSDriver*) { received.standard++; }
+static void broadcast_cb(USSDriver*) { received.broadcast++; }
+static void special_cb(USSDriver*) { received.special++; }
+static void any_cb(USSDriver* ussp) {
+    if(received.any < (int)(sizeof(received.status) / sizeof(received.status[0]))) {
+        received.status[received.any] = ussp->status;
+    }
+    received.any++;
+    memcpy(&received.last, ussp->rxTelegram, sizeof(Telegram_t));
+    received.last_ns = uss_sim.now_ns;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+static USSConfig config = {
+    .uartp = NULL,
+    .rs485_en_line = PAL_NOLINE,
+    .gpt = NULL,
+    .speed = 187500,
+    .node_nb = NODE,
+    .standard_cb = standard_cb,
+    .broadcast_cb = broadcast_cb,
+    .special_cb = special_cb,
+    .any_cb = any_cb,
+    .silent = false,
+    .user_data = NULL,
+    .mode = USS_MODE_SLAVE,
+};
+#pragma GCC diagnostic pop
+
+static void setUp(uint32_t speed) {
+    if(uss_sim.ussp != NULL) {
+        ussStop(&uss);
+    }
+    memset(&received, 0, sizeof(received));
+    memset(&uss, 0, sizeof(uss));
+    config.speed = speed;
+    ussSimReset(speed);
+    ussStart(&uss, &config);
+}
+
+/**
+ * Telegram of `n` data bytes to `adr`, with its BCC.
+ * @return the telegram length, STX to BCC.
+ */
+static size_t makeTelegram(uint8_t* buf, uint8_t adr, const uint8_t* data, size_t n) {
+    buf[0] = USS_STX;
+    buf[1] = n + 2;
+    buf[2] = adr;
+    memcpy(buf + 3, data, n);
+    buf[3 + n] = ussBccBytes(buf, 3 + n);
+    return n + 4;
+}
+
+static const uint8_t net_data[12] = {0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x7F, 0x20, 0x00};
+
+static void feedTelegram(uint8_t adr) {
+    uint8_t tlgm[sizeof(Telegram_t) + 1];
+    size_t len = makeTelegram(tlgm, adr, net_data, sizeof(net_data));
+    ussSimFeed(tlgm, len, 0);
+}
+
+static void testTelegramTypes(void) {
+    setUp(187500);
+    feedTelegram(NODE);             // standard, to us
+    feedTelegram(NODE + 1);         // standard, to another node
+    feedTelegram(0x20 | 7);         // broadcast
+    feedTelegram(0x80 | NODE);      // special
+    ussSimRunIdle();
+
+    CHECK(received.standard == 1);
+    CHECK(received.broadcast == 1);
+    CHECK(received.special == 1);
+    CHECK(received.any == 4);
+    for(int i = 0; i < 4; i++) {
+        CHECK(received.status[i] == USS_OK);
+    }
+    CHECK(received.last.adr == (0x80 | NODE));
+    CHECK(memcmp(received.last.data, net_data, sizeof(net_data)) == 0);
+    CHECK(uss.stats.standard == 2);
+    CHECK(uss.stats.broadcast == 1);
+    CHECK(uss.stats.special == 1);
+    CHECK(uss.stats.gaps == 3);
+    CHECK(uss_sim.nb_tx == 0);
+}
+
+static void testMirror(void) {
+    setUp(187500);
+    feedTelegram(0x40 | (NODE + 1));    // mirror for another node
+    feedTelegram(0x40 | NODE);
+    ussSimRunIdle();
+
+    CHECK(uss.stats.mirror == 2);
+    CHECK(received.any == 2);
+    CHECK(uss_sim.nb_tx == 1);
+    CHECK(uss_sim.timer_bits == USS_TX_DELAY_BITS);
+    uint8_t tlgm[sizeof(Telegram_t) + 1];
+    size_t len = makeTelegram(tlgm, 0x40 | NODE, net_data, sizeof(net_data));
+    CHECK(uss_sim.tx[0].len == len);
+    CHECK(memcmp(uss_sim.tx[0].data, tlgm, len) == 0);
+    // sent one response delay after the end of the telegram, rounded up to the 1us timer tick
+    const uint64_t rx_end = uss_sim.rx_end_ns[uss_sim.rx_tail - 1];
+    CHECK(uss_sim.tx[0].start_ns >= rx_end + USS_TX_DELAY_BITS * uss_sim.bit_ns);
+    CHECK(uss_sim.tx[0].start_ns <= rx_end + USS_TX_DELAY_BITS * uss_sim.bit_ns + 1000);
+    CHECK(uss.delayStats.count == 1);
+    CHECK(uss.txState == USS_TX_IDLE);
+    CHECK(!uss_sim.tx_enable);
+
+    // a second mirror telegram while the reply to the first one is sent
+    // is not answered: the transmit buffer is busy
+    setUp(187500);
+    feedTelegram(0x40 | NODE);
+    ussSimRun(16 * 11 * uss_sim.bit_ns);
+    CHECK(uss.txState == USS_TX_RSP_WAIT);
+    feedTelegram(0x40 | NODE);
+    ussSimRun(16 * 11 * uss_sim.bit_ns);
+    CHECK(uss.txState == USS_TX_SENDING);
+    CHECK(uss.stats.mirror == 2);
+    CHECK(uss.stats.mirror_drops == 1);
+    feedTelegram(0x40 | NODE);
+    ussSimRunIdle();
+    CHECK(uss.stats.mirror_drops == 1);
+    CHECK(uss_sim.nb_tx == 2);
+    CHECK(uss_sim.timer_busy == 0);
+    CHECK(uss_sim.send_busy == 0);
+
+    config.silent = true;
+    setUp(187500);
+    feedTelegram(0x40 | NODE);
+    ussSimRunIdle();
+    CHECK(uss_sim.nb_tx == 1);
+    CHECK(!uss_sim.tx_enable);
+    config.silent = false;
+}
+
+static void testErrors(void) {
+    setUp(187500);
+    uint8_t tlgm[sizeof(Telegram_t) + 1];
+    size_t len = makeTelegram(tlgm, NODE, net_data, sizeof(net_data));
+    tlgm[5] ^= 0x01;
+    ussSimFeed(tlgm, len, 0);
+    ussSimRunIdle();
+    CHECK(received.any == 1);
+    CHECK(received.status[0] == USS_BCC_MISMATCH);
+    CHECK(received.standard == 0);
+    CHECK(uss.stats.bcc_errors == 1);
+
+    // LGE out of range: the telegram is ignored, the following bytes too
+    // until the next STX
+    setUp(187500);
+    const uint8_t short_lge[] = {USS_STX, 1, NODE};
+    ussSimFeed(short_lge, sizeof(short_lge), 0);
+    const uint8_t long_lge[] = {USS_STX, USS_TELEGRAM_LEN + 2, NODE};
+    ussSimFeed(long_lge, sizeof(long_lge), 40);
+    feedTelegram(NODE);
+    ussSimRunIdle();
+    CHECK(uss.stats.bad_lge == 2);
+    CHECK(received.standard == 1);
+    CHECK(received.status[received.any - 1] == USS_OK);
+
+    // parity error in the middle of a telegram: reception stopped, the
+    // next telegram is received
+    setUp(187500);
+    ussSimFeed(tlgm, 6, 0);
+    ussSimRun(6 * 11 * uss_sim.bit_ns);
+    ussSimRxError(USS_RX_ERR_PARITY | USS_RX_ERR_FRAMING);
+    feedTelegram(NODE);
+    ussSimRunIdle();
+    CHECK(uss.stats.parity_errors == 1);
+    CHECK(uss.stats.framing_errors == 1);
+    CHECK(received.standard == 1);
+    CHECK(received.any == 1);
+}
+
+static void testStalledTelegram(void) {
+    setUp(187500);
+    uint8_t tlgm[sizeof(Telegram_t) + 1];
+    makeTelegram(tlgm, NODE, net_data, sizeof(net_data));
+    // STX alone: dropped silently
+    ussSimFeed(tlgm, 1, 0);
+    // STX, LGE and part of the data
+    ussSimFeed(tlgm, 8, 100);
+    ussSimRunIdle();
+    CHECK(received.any == 1);
+    CHECK(received.status[0] == USS_RX_TIMEOUT);
+    CHECK(uss.stats.timeouts == 1);
+    CHECK(uss.rxState == USS_RX_STX);
+
+    feedTelegram(NODE);
+    ussSimRunIdle();
+    CHECK(received.standard == 1);
+    CHECK(received.status[1] == USS_OK);
+    CHECK(uss_sim.receive_busy == 0);
+}
+
+// USS timing at the recommended data rates, and 115200 bauds used on the
+// second bus
+static void testTiming(void) {
+    static const uint32_t speeds[] = {9600, 19200, 38400, 115200, 187500};
+    for(uint32_t speed : speeds) {
+        // start interval / response delay: at least 2 characters, less than
+        // a timer tick more, far below the 20ms maximum response delay
+        const uint64_t ticks = ussBitsToTicks(USS_TX_DELAY_BITS, speed, USS_GPT_FREQ);
+        CHECK(ticks * speed >= (uint64_t)USS_TX_DELAY_BITS * USS_GPT_FREQ);
+        CHECK((ticks - 1) * speed < (uint64_t)USS_TX_DELAY_BITS * USS_GPT_FREQ);
+        CHECK(ticks * 1000 < 20ULL * USS_GPT_FREQ);
+
+        // characters up to 2 character times apart belong to the telegram
+        setUp(speed);
+        uint8_t tlgm[sizeof(Telegram_t) + 1];
+        size_t len = makeTelegram(tlgm, 0x40 | NODE, net_data, sizeof(net_data));
+        ussSimFeedSpaced(tlgm, len, 2 * 11);
+        ussSimRunIdle();
+        CHECK(received.any == 1);
+        CHECK(received.status[0] == USS_OK);
+        CHECK(uss.stats.timeouts == 0);
+        // replied after the response delay
+        CHECK(uss_sim.nb_tx == 1);
+        const uint64_t rx_end = uss_sim.rx_end_ns[uss_sim.rx_tail - 1];
+        CHECK(uss_sim.tx[0].start_ns - rx_end == ticks * (1000000000 / USS_GPT_FREQ));
+        CHECK(uss_sim.tx[0].start_ns - rx_end >= USS_TX_DELAY_BITS * uss_sim.bit_ns);
+
+        // one bit more and the telegram has stalled: reported 2 characters
+        // after the last one
+        setUp(speed);
+        ussSimFeed(tlgm, 5, 0);
+        ussSimFeedSpaced(tlgm + 5, 1, 2 * 11 + 1);
+        ussSimRunIdle();
+        CHECK(received.any == 1);
+        CHECK(received.status[0] == USS_RX_TIMEOUT);
+        CHECK(uss.stats.timeouts == 1);
+        CHECK(received.last_ns == uss_sim.rx_end_ns[4] + USS_RX_IDLE_BITS * uss_sim.bit_ns);
+    }
+}
+
+// a log record of each telegram, as uss_handler.cpp writes them
+static size_t logTelegram(uint8_t* log, const uint8_t* tlgm, size_t len, USSError status, uint32_t cycles) {
+    UssLogRecordHeader hdr = {.magic = USS_LOG_MAGIC, .length = (uint8_t)len, .status = (uint8_t)status,
+                              .time = cycles / (STM32_SYSCLK / CH_CFG_ST_FREQUENCY), .cycles = cycles};
+    memcpy(log, &hdr, sizeof(hdr));
+    memcpy(log + sizeof(hdr), tlgm, len);
+    return sizeof(hdr) + len;
+}
+
+static void testReplay(void) {
+    static uint8_t log[16 * sizeof(UssLogRecord)];
+    size_t log_len = 0;
+    uint8_t tlgm[sizeof(Telegram_t) + 1];
+    const uint32_t period = STM32_SYSCLK / 1000 * 2;     // a telegram every 2ms
+    uint32_t cycles = 0xFFFFFFFF - period;              // realtime counter wrap in the log
+
+    size_t len = makeTelegram(tlgm, NODE, net_data, sizeof(net_data));
+    log_len += logTelegram(log + log_len, tlgm, len, USS_OK, cycles += period);
+    len = makeTelegram(tlgm, 0x40 | NODE, net_data, 4);
+    log_len += logTelegram(log + log_len, tlgm, len, USS_OK, cycles += period);
+    len = makeTelegram(tlgm, NODE, net_data, sizeof(net_data));
+    tlgm[4] ^= 0x80;
+    log_len += logTelegram(log + log_len, tlgm, len, USS_BCC_MISMATCH, cycles += period);
+    len = makeTelegram(tlgm, NODE + 1, net_data, sizeof(net_data));
+    log_len += logTelegram(log + log_len, tlgm, 7, USS_RX_TIMEOUT, cycles += period);
+    len = makeTelegram(tlgm, 0x20, net_data, 2);
+    log_len += logTelegram(log + log_len, tlgm, len, USS_OK, cycles += period);
+
+    setUp(187500);
+    const uint64_t start = uss_sim.now_ns;
+    CHECK(ussSimReplayLog(log, log_len) == 5);
+    ussSimRunIdle();
+    CHECK(received.any == 5);
+    size_t pos = 0;
+    for(int i = 0; i < 5 && pos < log_len; i++) {
+        UssLogRecordHeader hdr;
+        memcpy(&hdr, log + pos, sizeof(hdr));
+        CHECK(received.status[i] == hdr.status);
+        pos += sizeof(hdr) + hdr.length;
+    }
+    CHECK(received.standard == 1);
+    CHECK(received.broadcast == 1);
+    CHECK(uss_sim.nb_tx == 1);
+    // recorded timing kept: the gaps are the recorded period minus the
+    // telegram, plus the STX character time (timestamped at its reception),
+    // 2 periods after the truncated one that never ended
+    CHECK(uss.stats.gaps == 4);
+    CHECK(uss_sim.now_ns - start >= 8000000);
+    CHECK(uss.stats.gap_min_us > 1100 && uss.stats.gap_min_us < 1150);
+    CHECK(uss.stats.gap_max_us > 3100 && uss.stats.gap_max_us < 3150);
+
+    CHECK(ussSimReplayLog(log, log_len - 1) == -1);
+}
+
+int main() {
+    testTelegramTypes();
+    testMirror();
+    testErrors();
+    testStalledTelegram();
+    testTiming();
+    testReplay();
+    CHECK(uss_sim.timer_busy == 0);
+    CHECK(uss_sim.send_busy == 0);
+    return testResult("uss");
+}
@@ -0,0 +1,34 @@
+// The word-wide BCC kernel against the byte loop reference.
+#include "uss_bcc.h"
+#include "test.h"
+#include <stdlib.h>
+
+int main() {
+    static uint8_t buffer[2 * sizeof(uint32_t) + 256];
+    srand(1234);
+    for(size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = rand();
+    }
+
+    // every length and alignment of the telegram sizes
+    for(size_t offset = 0; offset < 2 * sizeof(uint32_t); offset++) {
+        for(size_t n = 0; n <= 256; n++) {
+            CHECK(ussBccWords(buffer + offset, n) == ussBccBytes(buffer + offset, n));
+        }
+    }
+
+    // random contents, offsets and lengths
+    for(int i = 0; i < 100000; i++) {
+        const size_t offset = rand() % (2 * sizeof(uint32_t));
+        const size_t n = rand() % 257;
+        buffer[offset + rand() % 256] = rand();
+        CHECK(ussBccWords(buffer + offset, n) == ussBccBytes(buffer + offset, n));
+    }
+
+    // a telegram including its BCC XORs to 0
+    uint8_t tlgm[16] = {0x02, 14, 3, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    tlgm[15] = ussBccBytes(tlgm, 15);
+    CHECK(ussBccWords(tlgm, sizeof(tlgm)) == 0);
+
+    return testResult("uss_bcc");
+}
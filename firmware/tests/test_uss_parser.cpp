@@ -0,0 +1,123 @@
+#include "uss_parser.h"
+#include "test.h"
+#include <string.h>
+
+// telegram with `words` net data words 0x0102, 0x0304, ...
+static Telegram_t telegram(uint8_t adr, uint8_t words) {
+    Telegram_t tlgm = {};
+    tlgm.stx = USS_STX;
+    tlgm.lge = 2*words + 2;
+    tlgm.adr = adr;
+    for(uint8_t i=0; i<2*words; i++) {
+        tlgm.data[i] = i + 1;
+    }
+    return tlgm;
+}
+
+static void testPkw() {
+    UssNetData nd;
+
+    // no PKW area: everything is PZD
+    Telegram_t tlgm = telegram(0x23, 2);
+    CHECK(ussParseNetData(&tlgm, 0, 2, &nd));
+    CHECK(nd.node == 3);
+    CHECK(nd.pkw_words == 0);
+    CHECK(nd.pzd_words == 2);
+    CHECK(nd.pzd[0] == 0x0102);
+    CHECK(nd.pzd[1] == 0x0304);
+
+    // PKE (AK 0x2, SPM, PNU 0x7A5), IND, PWE
+    tlgm = telegram(1, 3 + 2);
+    ussWriteWord(tlgm.data, 0x2FA5);
+    ussWriteWord(tlgm.data + 2, 0x0007);
+    ussWriteWord(tlgm.data + 4, 0xBEEF);
+    CHECK(ussParseNetData(&tlgm, 3, 2, &nd));
+    CHECK(nd.pkw_words == 3);
+    CHECK(nd.pkw.ak == 0x2);
+    CHECK(nd.pkw.sp);
+    CHECK(nd.pkw.pnu == 0x7A5);
+    CHECK(nd.pkw.ind == 0x0007);
+    CHECK(nd.pkw.pwe == 0xBEEF);
+    CHECK(nd.pzd[0] == 0x0708);
+    CHECK(nd.pzd[1] == 0x090A);
+
+    // 4 words: PWE1 is the high word
+    tlgm = telegram(1, 4 + 2);
+    ussWriteWord(tlgm.data, 0x1123);
+    ussWriteWord(tlgm.data + 4, 0x1234);
+    ussWriteWord(tlgm.data + 6, 0x5678);
+    CHECK(ussParseNetData(&tlgm, 4, 2, &nd));
+    CHECK(nd.pkw_words == 4);
+    CHECK(nd.pkw.ak == 0x1);
+    CHECK(!nd.pkw.sp);
+    CHECK(nd.pkw.pnu == 0x123);
+    CHECK(nd.pkw.pwe == 0x12345678);
+    CHECK(nd.pzd[0] == 0x090A);
+    CHECK(nd.pzd[1] == 0x0B0C);
+
+    // PKW only
+    tlgm = telegram(1, 4);
+    CHECK(ussParseNetData(&tlgm, 4, 0, &nd));
+    CHECK(nd.pzd_words == 0);
+}
+
+static void testRejected() {
+    UssNetData nd;
+
+    // LGE of a 4 + 2 words telegram parsed with other lengths
+    Telegram_t tlgm = telegram(1, 6);
+    CHECK(ussParseNetData(&tlgm, 4, 2, &nd));
+    CHECK(!ussParseNetData(&tlgm, 4, 1, &nd));
+    CHECK(!ussParseNetData(&tlgm, 4, 3, &nd));
+    CHECK(!ussParseNetData(&tlgm, 3, 2, &nd));
+
+    // PKW areas are 0, 3 or 4 words, whatever the LGE
+    for(uint8_t pkw=1; pkw<8; pkw++) {
+        if(pkw == 3 || pkw == 4) {
+            continue;
+        }
+        tlgm = telegram(1, pkw + 2);
+        CHECK(!ussParseNetData(&tlgm, pkw, 2, &nd));
+    }
+
+    // at most USS_PZD_MAX PZD words, even with a matching LGE
+    tlgm = telegram(1, USS_PZD_MAX);
+    CHECK(ussParseNetData(&tlgm, 0, USS_PZD_MAX, &nd));
+    CHECK(nd.pzd[USS_PZD_MAX - 1] == (uint16_t)((2*USS_PZD_MAX - 1) << 8 | 2*USS_PZD_MAX));
+    tlgm = telegram(1, USS_PZD_MAX + 1);
+    CHECK(!ussParseNetData(&tlgm, 0, USS_PZD_MAX + 1, &nd));
+}
+
+static void testPercent() {
+    CHECK(ussPercentToPzd(0.0f) == 0);
+    CHECK(ussPercentToPzd(100.0f) == USS_PZD_100_PERCENT);
+    CHECK(ussPercentToPzd(-100.0f) == (uint16_t)-USS_PZD_100_PERCENT);
+    CHECK(ussPzdToPercent(0) == 0.0f);
+    CHECK(ussPzdToPercent(USS_PZD_100_PERCENT) == 100.0f);
+    CHECK(ussPzdToPercent((uint16_t)-USS_PZD_100_PERCENT) == -100.0f);
+    CHECK(ussPzdToPercent(0x8000) == -200.0f);
+    CHECK_CLOSE(ussPzdToPercent(0x7FFF), 200.0 - 100.0 / USS_PZD_100_PERCENT, 1e-6);
+
+    // every word goes back to itself
+    int mismatches = 0;
+    for(uint32_t w=0; w<=0xFFFF; w++) {
+        mismatches += ussPercentToPzd(ussPzdToPercent(w)) != w;
+    }
+    CHECK(mismatches == 0);
+
+    // saturated out of the range
+    CHECK(ussPercentToPzd(200.0f) == 0x7FFF);
+    CHECK(ussPercentToPzd(1e9f) == 0x7FFF);
+    CHECK(ussPercentToPzd(INFINITY) == 0x7FFF);
+    CHECK(ussPercentToPzd(-200.0f) == 0x8000);
+    CHECK(ussPercentToPzd(-1e9f) == 0x8000);
+    CHECK(ussPercentToPzd(-INFINITY) == 0x8000);
+    CHECK(ussPercentToPzd(NAN) == 0);
+}
+
+int main() {
+    testPkw();
+    testRejected();
+    testPercent();
+    return testResult("uss_parser");
+}
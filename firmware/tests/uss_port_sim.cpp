@@ -0,0 +1,212 @@
+#include "uss_port_sim.h"
+#include "uss_log.h"
+#include <string.h>
+
+#define CHAR_BITS 11
+
+UssSim uss_sim;
+
+void ussSimReset(uint32_t speed) {
+    const uint64_t now = uss_sim.now_ns;
+    memset(&uss_sim, 0, sizeof(uss_sim));
+    uss_sim.now_ns = now;
+    uss_sim.line_free_ns = now;
+    uss_sim.bit_ns = 1000000000ULL / speed;
+}
+
+// queue bytes on the line `gap_bits` apart, the first one starting at `t`
+// at the earliest
+static void queueBytes(uint64_t t, const uint8_t* bytes, size_t n, uint32_t gap_bits) {
+    if(t < uss_sim.line_free_ns) {
+        t = uss_sim.line_free_ns;
+    }
+    if(uss_sim.rx_head == uss_sim.rx_tail) {
+        uss_sim.rx_head = uss_sim.rx_tail = 0;
+    }
+    for(size_t i = 0; i < n; i++) {
+        chDbgAssert(uss_sim.rx_tail < USS_SIM_RX_LEN, "USS sim: receive queue full");
+        if(i > 0) {
+            t += gap_bits * uss_sim.bit_ns;
+        }
+        t += CHAR_BITS * uss_sim.bit_ns;
+        uss_sim.rx_bytes[uss_sim.rx_tail] = bytes[i];
+        uss_sim.rx_end_ns[uss_sim.rx_tail] = t;
+        uss_sim.rx_tail++;
+    }
+    uss_sim.line_free_ns = t;
+}
+
+void ussSimFeed(const uint8_t* bytes, size_t n, uint32_t idle_bits) {
+    queueBytes(uss_sim.now_ns + idle_bits * uss_sim.bit_ns, bytes, n, 0);
+}
+
+void ussSimFeedSpaced(const uint8_t* bytes, size_t n, uint32_t gap_bits) {
+    queueBytes(uss_sim.line_free_ns + gap_bits * uss_sim.bit_ns, bytes, n, gap_bits);
+}
+
+int ussSimReplayLog(const uint8_t* log, size_t len) {
+    const uint64_t start = uss_sim.line_free_ns > uss_sim.now_ns ? uss_sim.line_free_ns : uss_sim.now_ns;
+    uint32_t first_cycles = 0;
+    int nb = 0;
+    for(size_t pos = 0; pos < len; nb++) {
+        UssLogRecordHeader hdr;
+        if(len - pos < sizeof(hdr)) {
+            return -1;
+        }
+        memcpy(&hdr, log + pos, sizeof(hdr));
+        if(hdr.magic != USS_LOG_MAGIC || len - pos - sizeof(hdr) < hdr.length) {
+            return -1;
+        }
+        if(nb == 0) {
+            first_cycles = hdr.cycles;
+        }
+        // STX at its recorded time, or right after the previous telegram
+        const uint32_t cycles = hdr.cycles - first_cycles;
+        queueBytes(start + (uint64_t)cycles * 1000 / (STM32_SYSCLK / 1000000), log + pos + sizeof(hdr), hdr.length, 0);
+        pos += sizeof(hdr) + hdr.length;
+    }
+    return nb;
+}
+
+void ussSimRxError(uint32_t errors) {
+    ussRxError(uss_sim.ussp, errors);
+}
+
+static void advanceTo(uint64_t t) {
+    simAdvanceNs(t - uss_sim.now_ns);
+    uss_sim.now_ns = t;
+}
+
+static void receiveByte(void) {
+    const uint8_t c = uss_sim.rx_bytes[uss_sim.rx_head++];
+    uss_sim.idle_armed = true;
+    uss_sim.idle_ns = uss_sim.now_ns + USS_RX_IDLE_BITS * uss_sim.bit_ns;
+    if(uss_sim.dma_buf == NULL) {
+        ussRxChar(uss_sim.ussp, c);
+        return;
+    }
+    *uss_sim.dma_buf++ = c;
+    if(--uss_sim.dma_left == 0) {
+        uss_sim.dma_buf = NULL;
+        ussRxEnd(uss_sim.ussp);
+    }
+}
+
+typedef enum { EV_NONE, EV_RX, EV_IDLE, EV_TIMER, EV_TX_END } UssSimEvent;
+
+// earliest event, the first in this order for events at the same time
+static void earliest(UssSimEvent* ev, uint64_t* t, bool active, uint64_t at, UssSimEvent candidate, uint64_t until) {
+    if(active && at <= until && (*ev == EV_NONE || at < *t)) {
+        *ev = candidate;
+        *t = at;
+    }
+}
+
+static bool runNext(uint64_t until) {
+    UssSimEvent ev = EV_NONE;
+    uint64_t t = 0;
+    const bool rx = uss_sim.rx_head < uss_sim.rx_tail;
+    earliest(&ev, &t, rx, rx ? uss_sim.rx_end_ns[uss_sim.rx_head] : 0, EV_RX, until);
+    // the receiver timeout counter restarts on the start bit of the next character
+    const bool restarted = rx && uss_sim.rx_end_ns[uss_sim.rx_head] - CHAR_BITS * uss_sim.bit_ns <= uss_sim.idle_ns;
+    earliest(&ev, &t, uss_sim.idle_armed && !restarted, uss_sim.idle_ns, EV_IDLE, until);
+    earliest(&ev, &t, uss_sim.timer_running, uss_sim.timer_ns, EV_TIMER, until);
+    earliest(&ev, &t, uss_sim.sending, uss_sim.tx_end_ns, EV_TX_END, until);
+    if(ev == EV_NONE) {
+        return false;
+    }
+
+    advanceTo(t);
+    chDbgAssert(sim_lock == 0, "USS port callback called locked");
+    switch(ev) {
+    case EV_RX:
+        receiveByte();
+        break;
+    case EV_IDLE:
+        uss_sim.idle_armed = false;
+        ussRxIdle(uss_sim.ussp);
+        break;
+    case EV_TIMER:
+        uss_sim.timer_running = false;
+        ussTimeout(uss_sim.ussp);
+        break;
+    case EV_TX_END:
+        uss_sim.sending = false;
+        ussTxEnd(uss_sim.ussp);
+        break;
+    default:
+        break;
+    }
+    chDbgAssert(sim_lock == 0, "USS port callback returned locked");
+    return true;
+}
+
+void ussSimRun(uint64_t ns) {
+    const uint64_t until = uss_sim.now_ns + ns;
+    while(runNext(until)) {
+    }
+    advanceTo(until);
+}
+
+void ussSimRunIdle(void) {
+    while(runNext(UINT64_MAX)) {
+    }
+}
+
+void ussPortStart(USSDriver* ussp) {
+    uss_sim.ussp = ussp;
+    ussPortSetTxEnable(ussp, false);
+}
+
+void ussPortStop(USSDriver*) {
+    uss_sim.ussp = NULL;
+}
+
+void ussPortReceiveI(USSDriver*, size_t n, uint8_t* buf) {
+    chDbgCheckClassI();
+    if(uss_sim.dma_buf != NULL) {
+        uss_sim.receive_busy++;
+    }
+    uss_sim.dma_buf = buf;
+    uss_sim.dma_left = n;
+}
+
+void ussPortStopReceiveI(USSDriver*) {
+    chDbgCheckClassI();
+    uss_sim.dma_buf = NULL;
+    uss_sim.dma_left = 0;
+}
+
+void ussPortStartTimeoutI(USSDriver* ussp, uint32_t bits) {
+    chDbgCheckClassI();
+    if(uss_sim.timer_running) {
+        uss_sim.timer_busy++;
+        return;
+    }
+    // same rounding as uss_port.cpp
+    const uint64_t ticks = ussBitsToTicks(bits, ussp->config->speed, USS_GPT_FREQ);
+    uss_sim.timer_running = true;
+    uss_sim.timer_ns = uss_sim.now_ns + ticks * (1000000000 / USS_GPT_FREQ);
+    uss_sim.timer_starts++;
+    uss_sim.timer_bits = bits;
+}
+
+void ussPortSetTxEnable(USSDriver*, bool enable) {
+    uss_sim.tx_enable = enable;
+}
+
+void ussPortSendI(USSDriver*, size_t n, const uint8_t* buf) {
+    chDbgCheckClassI();
+    if(uss_sim.sending) {
+        uss_sim.send_busy++;
+        return;
+    }
+    if(uss_sim.nb_tx < USS_SIM_TX_NB) {
+        UssSimTx* tx = &uss_sim.tx[uss_sim.nb_tx++];
+        tx->start_ns = uss_sim.now_ns;
+        tx->len = n;
+        memcpy(tx->data, buf, n);
+    }
+    uss_sim.sending = true;
+    uss_sim.tx_end_ns = uss_sim.now_ns + n * CHAR_BITS * uss_sim.bit_ns;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "USS.h"
+
+// Host port of the USS protocol engine (see source/uss_port.h), on a
+// simulated bus with virtual time.
+// Bytes queued with ussSimFeed are received back to back, one character time
+// (11 bits) each. The receiver timeout fires USS_RX_IDLE_BITS after the stop
+// bit of a character unless a start bit follows. The receiver timeout, the
+// response timer and the end of the transmissions fire at their time while
+// ussSimRun advances the clock, which also drives the simulated ChibiOS clock
+// (chVTGetSystemTimeX and the realtime counter). What the engine asks the
+// port is recorded in uss_sim.
+
+#define USS_SIM_RX_LEN 4096
+#define USS_SIM_TX_NB 16
+
+typedef struct {
+    uint64_t start_ns;          // first bit on the line
+    size_t len;
+    uint8_t data[sizeof(Telegram_t)];
+} UssSimTx;
+
+typedef struct {
+    USSDriver* ussp;
+    uint64_t now_ns;
+    uint64_t bit_ns;
+
+    // receiver
+    uint8_t rx_bytes[USS_SIM_RX_LEN];
+    uint64_t rx_end_ns[USS_SIM_RX_LEN];     // end of the stop bit of each byte
+    size_t rx_head;
+    size_t rx_tail;
+    uint64_t line_free_ns;                  // end of the last queued byte
+    uint8_t* dma_buf;                       // ussPortReceiveI buffer, NULL if not receiving
+    size_t dma_left;
+    bool idle_armed;                        // receiver timeout
+    uint64_t idle_ns;
+
+    // response timer
+    bool timer_running;
+    uint64_t timer_ns;
+    uint32_t timer_starts;
+    uint32_t timer_bits;                    // last ussPortStartTimeoutI argument
+
+    // transmitter
+    bool tx_enable;
+    bool sending;
+    uint64_t tx_end_ns;
+    UssSimTx tx[USS_SIM_TX_NB];
+    size_t nb_tx;
+
+    // port misuse, each one trips a ChibiOS assertion on the target
+    uint32_t timer_busy;        // gptStartOneShotI on a running timer
+    uint32_t send_busy;         // uartStartSendI during a transmission
+    uint32_t receive_busy;      // uartStartReceiveI during a reception
+} UssSim;
+
+extern UssSim uss_sim;
+
+/**
+ * Reset the simulated bus, before ussStart. The clock keeps running.
+ */
+void ussSimReset(uint32_t speed);
+
+/**
+ * Queue bytes on the line, back to back after the bytes already queued,
+ * and at least `idle_bits` bit times after the current time.
+ */
+void ussSimFeed(const uint8_t* bytes, size_t n, uint32_t idle_bits);
+
+/**
+ * Queue bytes on the line with `gap_bits` of idle line before each of them,
+ * after the bytes already queued.
+ */
+void ussSimFeedSpaced(const uint8_t* bytes, size_t n, uint32_t gap_bits);
+
+/**
+ * Queue the telegrams of a USS log (see source/uss_log.h) with their recorded
+ * timing, starting now.
+ * @return the number of telegrams queued, -1 if the log is corrupted.
+ */
+int ussSimReplayLog(const uint8_t* log, size_t len);
+
+/**
+ * Reception error signaled by the UART now.
+ */
+void ussSimRxError(uint32_t errors);
+
+/**
+ * Run the bus for `ns` nanoseconds, calling the engine entry points at
+ * their time.
+ */
+void ussSimRun(uint64_t ns);
+
+/**
+ * Run the bus until nothing is left to happen: queue empty, line idle and
+ * timers expired.
+ */
+void ussSimRunIdle(void);
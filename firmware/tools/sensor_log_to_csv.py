@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Convert a binary sensor log (see source/sensor_log.h) to CSV."""
+import argparse
+import struct
+import sys
+
+BLOCK_SIZE = 512
+MAGIC = 0x4C53
+HEADER = struct.Struct("<HBBI")
+RECORDS = {
+    # version: (record struct, csv columns)
+    1: (struct.Struct("<IHHffff"),
+        ["time", "flags", "tunnel_temp", "temp", "diff_p", "pressure"]),
+    2: (struct.Struct("<IHHfffff"),
+        ["time", "flags", "updated", "tunnel_temp", "temp", "diff_p", "pressure", "diff_p_raw"]),
+    3: (struct.Struct("<IHHffffff"),
+        ["time", "flags", "updated", "tunnel_temp", "temp", "diff_p", "pressure", "diff_p_raw", "fan_freq"]),
+}
+
+
+def decode(f, tick_freq):
+    """Yield (columns, row) for each record of the log file f."""
+    expected_seq = 0
+    while True:
+        block = f.read(BLOCK_SIZE)
+        if len(block) < BLOCK_SIZE:
+            if block:
+                print("truncated block ignored", file=sys.stderr)
+            return
+        magic, version, count, seq = HEADER.unpack_from(block)
+        if magic != MAGIC or version not in RECORDS:
+            print(f"invalid block {expected_seq} (magic {magic:#x}, version {version})", file=sys.stderr)
+            continue
+        if seq != expected_seq:
+            print(f"missing blocks {expected_seq} to {seq - 1}", file=sys.stderr)
+        expected_seq = seq + 1
+        rec, columns = RECORDS[version]
+        for i in range(count):
+            ts, flags, updated, *values = rec.unpack_from(block, HEADER.size + i * rec.size)
+            ints = [str(flags), str(updated)] if version >= 2 else [str(flags)]
+            yield columns, [f"{ts / tick_freq:.4f}"] + ints + [f"{v:.4f}" for v in values]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("log", help="binary log file")
+    parser.add_argument("-o", "--output", help="CSV output file (default: stdout)")
+    parser.add_argument("--tick-freq", type=float, default=10000,
+                        help="system tick frequency (CH_CFG_ST_FREQUENCY), default 10000")
+    args = parser.parse_args()
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    header_written = None
+    with open(args.log, "rb") as f:
+        for columns, row in decode(f, args.tick_freq):
+            if columns != header_written:
+                out.write(",".join(columns) + "\n")
+                header_written = columns
+            out.write(",".join(row) + "\n")
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Decode a binary USS telegram log (see source/uss_log.h).
+
+Prints the bus timeline as CSV and, with --stats, the master poll cycle time
+and slave response latency per node.
+A task and its response carry the same ADR: on each address, telegrams are
+assumed to alternate task / response, starting with a task. Times are taken
+at STX: the response latency includes the task transmission time.
+"""
+import argparse
+import struct
+import sys
+
+MAGIC = 0x5355
+HEADER = struct.Struct("<HBBII")
+# USSError of source/USS.h, in the same order
+STATUS = ["ok", "bcc_mismatch", "rx_timeout", "bad_lge", "no_response"]
+
+
+def decode(data):
+    """Yield (time_ticks, cycles, status, telegram bytes) for each record, resynchronising on errors."""
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        magic, length, status, time, cycles = HEADER.unpack_from(data, pos)
+        end = pos + HEADER.size + length
+        if magic != MAGIC or length < 3 or end > len(data):
+            nxt = data.find(struct.pack("<H", MAGIC), pos + 1)
+            if nxt < 0:
+                print(f"trailing garbage at offset {pos}", file=sys.stderr)
+                return
+            print(f"skipped {nxt - pos} bytes at offset {pos}", file=sys.stderr)
+            pos = nxt
+            continue
+        yield time, cycles, status, data[pos + HEADER.size:end]
+        pos = end
+
+
+def timeline(records, tick_freq, cpu_freq):
+    """Yield (t, status, telegram): t in seconds from the first record.
+    The tick time gives the coarse time, the cycle counter refines the
+    interval between consecutive records when it did not wrap."""
+    wrap = 2**32 / cpu_freq
+    t = None
+    for time, cycles, status, tlgm in records:
+        if t is None:
+            t = 0.0
+        else:
+            coarse = ((time - prev_time) % 2**32) / tick_freq
+            fine = ((cycles - prev_cycles) % 2**32) / cpu_freq
+            # the cycle counter is valid if the coarse interval is within a wrap period
+            t += fine if abs(fine - coarse) < 2 / tick_freq and coarse < wrap / 2 else coarse
+        prev_time, prev_cycles = time, cycles
+        yield t, status, tlgm
+
+
+def stats(events):
+    """Poll cycle time and response latency per address."""
+    per_adr = {}
+    for t, status, tlgm in events:
+        if status != 0:
+            continue
+        adr = tlgm[2] & 0x1F
+        s = per_adr.setdefault(adr, {"last_task": None, "pending": False, "cycles": [], "latencies": []})
+        if not s["pending"]:
+            if s["last_task"] is not None:
+                s["cycles"].append(t - s["last_task"])
+            s["last_task"] = t
+            s["pending"] = True
+        else:
+            s["latencies"].append(t - s["last_task"])
+            s["pending"] = False
+    return per_adr
+
+
+def summary(name, values):
+    if not values:
+        return f"{name}: -"
+    values = sorted(values)
+    mean = sum(values) / len(values)
+    return (f"{name}: n={len(values)} min={values[0] * 1e3:.3f} ms mean={mean * 1e3:.3f} ms "
+            f"max={values[-1] * 1e3:.3f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="binary log file")
+    parser.add_argument("-o", "--output", help="CSV output file (default: stdout)")
+    parser.add_argument("--stats", action="store_true", help="print poll cycle and response latency per address")
+    parser.add_argument("--tick-freq", type=float, default=10000,
+                        help="system tick frequency (CH_CFG_ST_FREQUENCY), default 10000")
+    parser.add_argument("--cpu-freq", type=float, default=216e6,
+                        help="realtime counter frequency (core clock), default 216e6")
+    args = parser.parse_args()
+
+    with open(args.log, "rb") as f:
+        data = f.read()
+    events = list(timeline(decode(data), args.tick_freq, args.cpu_freq))
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    out.write("time,dt,status,adr,lge,data\n")
+    prev = None
+    for t, status, tlgm in events:
+        dt = "" if prev is None else f"{(t - prev) * 1e3:.3f}"
+        prev = t
+        name = STATUS[status] if status < len(STATUS) else str(status)
+        out.write(f"{t:.6f},{dt},{name},{tlgm[2]:#04x},{tlgm[1]},{tlgm[3:].hex()}\n")
+    if out is not sys.stdout:
+        out.close()
+
+    if args.stats:
+        for adr, s in sorted(stats(events).items()):
+            print(f"node {adr}", file=sys.stderr)
+            print("  " + summary("poll cycle", s["cycles"]), file=sys.stderr)
+            print("  " + summary("response latency", s["latencies"]), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()